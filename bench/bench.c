@@ -0,0 +1,197 @@
+/*
+ * bench.c
+ *
+ *      Synthetic load generator and measurement harness for fileguard.
+ *      Spawns the real binary against a scratch directory, generates
+ *      file-creation events at a configurable rate, pairs its stdout
+ *      event reports back to the operations that caused them, and
+ *      reports throughput, p50/p99 dispatch latency and kernel drops.
+ *
+ *      Usage: ./bench/bench [-b ./fileguard] [-d dir] [-n count] [-r rate] [-l namelen]
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+#define DEFAULT_COUNT   10000
+#define DEFAULT_RATE    5000        /* events per second; 0 = unpaced */
+#define DEFAULT_NAMELEN 16
+#define LINE_MAX_LEN    512
+
+static char *binary = "./fileguard";
+static char *basedir = NULL;
+static int count = DEFAULT_COUNT;
+static int rate = DEFAULT_RATE;
+static int namelen = DEFAULT_NAMELEN;
+
+
+/* monotonic clock in nanoseconds */
+static int64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static int
+cmp_i64(const void * a, const void * b)
+{
+    int64_t d = *(const int64_t *) a - *(const int64_t *) b;
+    return (d > 0) - (d < 0);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "b:d:n:r:l:h")) != -1) {
+        switch (c) {
+            case 'b': binary = optarg; break;
+            case 'd': basedir = optarg; break;
+            case 'n': count = atoi(optarg); break;
+            case 'r': rate = atoi(optarg); break;
+            case 'l': namelen = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-b fileguard] [-d dir] [-n count] [-r rate] [-l namelen]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    /* scratch directory, preferably on tmpfs */
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s/fileguard-bench-XXXXXX",
+             basedir != NULL ? basedir
+             : (access("/dev/shm", W_OK) == 0 ? "/dev/shm" : "/tmp"));
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp failed. Reason");
+        exit(EXIT_FAILURE);
+    }
+
+    /* write a config watching the scratch dir with a log action, so
+     * measured cost is the pipeline and not per-event forks */
+    char config[320];
+    snprintf(config, sizeof(config), "%s/bench.yml", dir);
+    FILE *fp = fopen(config, "w");
+    if (fp == NULL) {
+        perror("Could not write bench config. Reason");
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fp, "inode: %s\nevent: IN_CREATE\naction: log %s/bench.fglog\n", dir, dir);
+    fclose(fp);
+
+    /* spawn fileguard with stdout piped back to us */
+    int pipefd[2];
+    if (pipe(pipefd) < 0) {
+        perror("pipe failed. Reason");
+        exit(EXIT_FAILURE);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed. Reason");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        dup2(pipefd[1], STDOUT_FILENO);
+        close(pipefd[0]);
+        close(pipefd[1]);
+        execl(binary, binary, config, (char *) NULL);
+        perror("exec failed. Reason");
+        _exit(EXIT_FAILURE);
+    }
+
+    close(pipefd[1]);
+    fcntl(pipefd[0], F_SETFL, O_NONBLOCK);
+
+    /* give it a moment to register the watch */
+    usleep(200 * 1000);
+
+    int64_t *t0 = malloc(count * sizeof(int64_t));
+    int64_t *lat = malloc(count * sizeof(int64_t));
+    if (t0 == NULL || lat == NULL) {
+        perror("malloc failed. Reason");
+        exit(EXIT_FAILURE);
+    }
+
+    int generated = 0, paired = 0, drops = 0;
+    int64_t pace_ns = (rate > 0) ? 1000000000LL / rate : 0;
+    int64_t start = now_ns(), next = start;
+    char line[LINE_MAX_LEN];
+    int line_len = 0;
+
+    while (paired < count) {
+        /* generate the next event, paced to the requested rate */
+        if (generated < count && (pace_ns == 0 || now_ns() >= next)) {
+            char path[384];
+            snprintf(path, sizeof(path), "%s/%0*i", dir, namelen, generated);
+            t0[generated] = now_ns();
+            int wfd = open(path, O_CREAT | O_WRONLY, 0644);
+            if (wfd >= 0)
+                close(wfd);
+            generated++;
+            next += pace_ns;
+        }
+
+        /* pair any event reports that have come back */
+        struct pollfd pfd = { .fd = pipefd[0], .events = POLLIN };
+        int timeout = (generated < count) ? 0 : 100;
+        if (poll(&pfd, 1, timeout) > 0) {
+            char chunk[4096];
+            ssize_t rd = read(pipefd[0], chunk, sizeof(chunk));
+            if (rd == 0)
+                break;
+            for (ssize_t i = 0; i < rd; i++) {
+                if (chunk[i] != '\n') {
+                    if (line_len < LINE_MAX_LEN - 1)
+                        line[line_len++] = chunk[i];
+                    continue;
+                }
+                line[line_len] = '\0';
+                line_len = 0;
+
+                /* pair only IN_CREATE reports: each create op also
+                 * emits IN_OPEN/IN_CLOSE_* lines, and counting those
+                 * would pair line N against the wrong t0 slot */
+                if (strstr(line, "IN_Q_OVERFLOW") != NULL)
+                    drops++;
+                else if (strstr(line, "IN_CREATE event ocurred") != NULL
+                        && paired < generated)
+                    lat[paired] = now_ns() - t0[paired], paired++;
+            }
+        } else if (generated >= count) {
+            /* generation done and the pipe has gone quiet */
+            break;
+        }
+    }
+
+    int64_t elapsed = now_ns() - start;
+    kill(pid, SIGINT);
+    waitpid(pid, NULL, 0);
+
+    /* report */
+    qsort(lat, paired, sizeof(int64_t), cmp_i64);
+    printf("generated:   %i events\n", generated);
+    printf("dispatched:  %i events (%.0f events/s)\n",
+           paired, paired / ((double) elapsed / 1e9));
+    printf("lost:        %i events, %i overflow reports\n", generated - paired, drops);
+    if (paired > 0) {
+        printf("p50 latency: %.3f ms\n", lat[paired / 2] / 1e6);
+        printf("p99 latency: %.3f ms\n", lat[(paired * 99) / 100] / 1e6);
+    }
+
+    free(t0);
+    free(lat);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,32 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+/* arena_t struct: a bump allocator over one fixed backing buffer. The
+ * event loop resets it once per drain cycle, so per-event scratch
+ * strings cost a pointer bump instead of malloc/free */
+typedef struct
+{
+    char * base;      /* backing buffer */
+    size_t cap;       /* backing buffer size */
+    size_t used;      /* current bump offset */
+} arena_t;
+
+/* initialize an arena over a freshly allocated backing buffer;
+ * returns 0 on success */
+int arena_init(arena_t * a, size_t cap);
+
+/* bump-allocate len bytes (8-byte aligned); NULL if the arena is full */
+void * arena_alloc(arena_t * a, size_t len);
+
+/* copy a string into the arena; NULL if the arena is full */
+char * arena_strdup(arena_t * a, const char * s);
+
+/* throw away everything allocated since the last reset */
+void arena_reset(arena_t * a);
+
+/* release the backing buffer */
+void arena_destroy(arena_t * a);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _BACKEND_H
+#define _BACKEND_H
+
+#include <stdint.h>
+#include <limits.h>
+#include <sys/inotify.h>
+
+/* which kernel notification API feeds the event loop. inotify is one
+ * watch per directory; fanotify covers a whole mount with one mark at
+ * constant kernel memory */
+typedef enum
+{
+    BACKEND_INOTIFY,
+    BACKEND_FANOTIFY,
+} backend_kind_t;
+
+/* the inotify-style mask bits the fanotify backend can actually
+ * deliver; directory-entry events (create, delete, moves) are not
+ * among them, so rules wanting those must use inotify */
+#define FANOTIFY_DELIVERABLE \
+    (IN_ACCESS | IN_MODIFY | IN_OPEN | IN_CLOSE_WRITE | IN_CLOSE_NOWRITE)
+
+/* fan_event_t struct: one fanotify record normalized to the shared
+ * dispatch surface (inotify-style mask + resolved path) */
+typedef struct
+{
+    uint32_t mask;           /* translated inotify-style mask */
+    char path[PATH_MAX];     /* full path resolved from the event fd */
+} fan_event_t;
+
+/* map a backend name from the config to its kind; -1 if unknown */
+int backend_from_name(const char * name);
+
+/* initialize fanotify; returns a pollable fd, or -1 */
+int fanotify_backend_init(void);
+
+/* place a whole-filesystem mark covering path; returns 0 on success */
+int fanotify_backend_mark(int fan_fd, char * path);
+
+/* decode the next record out of a drained buffer starting at off;
+ * fills out and returns bytes consumed, or 0 when the buffer is done */
+int fanotify_backend_next(char * buf, int len, int off, fan_event_t * out);
+
+#endif
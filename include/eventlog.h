@@ -0,0 +1,67 @@
+#ifndef _EVENTLOG_H
+#define _EVENTLOG_H
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+/* identifies a fileguard binary event log */
+#define EVENTLOG_MAGIC      0x46474C47      /* "FGLG" */
+#define EVENTLOG_VERSION    1
+
+/* record slots in the ring */
+#define EVENTLOG_CAPACITY   4096
+
+/* inline filename bytes per record (truncated if longer) */
+#define EVENTLOG_NAME_LEN   48
+
+/* flush dirty pages at most this often, in seconds */
+#define EVENTLOG_SYNC_SECS  1
+
+/* eventlog_hdr_t struct: fixed header at the front of the mapping */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;   /* number of record slots */
+    uint32_t head;       /* next slot; monotonically increasing */
+} eventlog_hdr_t;
+
+/* eventlog_rec_t struct: one fixed-size event record */
+typedef struct
+{
+    int64_t ts;                     /* wall-clock seconds */
+    int32_t wd;                     /* originating watch descriptor */
+    uint32_t mask;                  /* (merged) inotify event mask */
+    uint32_t count;                 /* raw events behind this record */
+    char name[EVENTLOG_NAME_LEN];   /* filename within the watch */
+} eventlog_rec_t;
+
+/* eventlog_t struct: an open, memory-mapped ring log. Handles are
+ * shared by path and refcounted: a recursive rule opens its log once
+ * per watched directory, and with sharded dispatch those appends come
+ * from different threads, so they must serialize on one lock rather
+ * than race head bumps across MAP_SHARED views of the same page */
+typedef struct eventlog
+{
+    int fd;
+    void * map;
+    size_t map_len;
+    time_t last_sync;
+    char * path;               /* registry key */
+    int refs;                  /* opens still holding this handle */
+    pthread_mutex_t lock;      /* serializes append across shards */
+    struct eventlog * next;    /* open-log registry chain */
+} eventlog_t;
+
+/* open (creating if needed) a ring log at path; an already-open path
+ * returns the shared handle. NULL on failure */
+eventlog_t * eventlog_open(char * path);
+
+/* append one record; never syscalls except for the periodic msync */
+void eventlog_append(eventlog_t * log, int wd, uint32_t mask, int count, const char * name);
+
+/* flush and unmap the log */
+void eventlog_close(eventlog_t * log);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _EXECUTOR_H
+#define _EXECUTOR_H
+
+#include <pthread.h>
+#include <time.h>
+#include <limits.h>
+
+/* default number of worker threads servicing the action queue */
+#define EXECUTOR_WORKERS    4
+
+/* bounded capacity of the pending-action queue */
+#define EXECUTOR_QUEUE_LEN  256
+
+/* maximum argv entries a command may be split into */
+#define EXECUTOR_MAX_ARGS   64
+
+/* inline command buffer per job; jobs never touch the heap */
+#define EXECUTOR_CMD_LEN    512
+
+/* inline event-path buffer per job: full PATH_MAX, so a deep recursive
+ * tree never hands a hook a truncated (and thus wrong) FG_PATH / %f */
+#define EXECUTOR_PATH_LEN   PATH_MAX
+
+/* spin up the worker pool; returns 0 on success */
+int executor_init(int workers);
+
+/* enqueue a command for asynchronous execution without blocking;
+ * returns -1 if the queue is full and the job was dropped. The event
+ * context rides along: children receive it as FG_PATH, FG_EVENT, FG_WD
+ * and FG_TIME in their environment, and the argv placeholders %f, %e,
+ * %w and %t are substituted with the same values. match_ts (may be
+ * NULL) feeds the match->spawn latency histogram */
+int executor_submit(const char * command, const char * path,
+                    const char * event, int wd,
+                    const struct timespec * match_ts);
+
+/* drain outstanding jobs and join the workers */
+void executor_shutdown(void);
+
+#endif
@@ -11,29 +11,75 @@
 #include <time.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <pthread.h>
 
 #include <sys/types.h>
+#include <sys/ioctl.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/inotify.h>
+#include <sys/epoll.h>
 
 #include <yaml.h>
 #include <glib.h>
 #include <libnotify/notify.h>
 
 #define CONFIG_FILE         "fileguard.yml"
-#define BUF_LEN             (10 * (sizeof(struct inotify_event) + NAME_MAX + 1))
+#define DEFAULT_PIDFILE     "/tmp/fileguard.pid"
+#define DRAIN_BUF_LEN       (4096 * (sizeof(struct inotify_event) + NAME_MAX + 1))
 #define DEFAULT_FILENAME    "fileguard.log"
 
-/* yaml_t struct: used to define key values that are to be returned when
- * parsing a standard fileguard configuration file
+/* filename matcher kinds, ordered cheapest-first; GLOB is the fnmatch
+ * fallback for patterns the fast paths cannot express */
+enum
+{
+  MATCH_ALL,            /* no pattern: everything matches */
+  MATCH_EXACT,          /* literal filename */
+  MATCH_PREFIX,         /* "foo*" */
+  MATCH_SUFFIX,         /* "*.log" */
+  MATCH_GLOB,           /* full fnmatch */
+};
+
+/* rule_t struct: one watch rule from the configuration file. A config
+ * holds one or more of these, each mapping an inode to an event and an
+ * action to perform when it fires
  */
 typedef struct
 {
   char * inode;         /* inode name */
   char * event;         /* event to watch for */
   char * action;        /* action of execution */
+  char * pattern;       /* filename filter, NULL matches everything */
+  uint32_t mask;        /* event compiled to its inotify mask bit */
+  bool recursive;       /* descend into subdirectories */
+  bool if_changed;      /* only act when file content actually changed */
+  int match_kind;       /* compiled pattern kind (MATCH_*) */
+  char * match_lit;     /* literal part for the fast-path kinds */
+  size_t match_len;     /* strlen(match_lit) */
+} rule_t;
+
+
+/* yaml_t struct: used to define key values that are to be returned when
+ * parsing a standard fileguard configuration file
+ */
+typedef struct
+{
+  void * pool;          /* single allocation backing rules and strings */
+  rule_t * rules;       /* flat rule array at the base of the pool */
+  int nrules;           /* number of rules in the array */
+  int coalesce_ms;      /* coalescing window in ms, 0 disables */
+  int queue_events;     /* requested kernel queue size, 0 keeps the default */
+  int suppress_ms;      /* duplicate-suppression TTL in ms, 0 disables */
+  int shards;           /* dispatcher threads, 0/1 keeps a single one */
+  int flush_ms;         /* stdout report latency bound, 0 keeps default */
+  char * backend;       /* notification backend name, NULL for inotify */
+  char * snapshot;      /* watch-state snapshot file, NULL disables */
+  char * stats;         /* stats endpoint socket path, NULL disables */
+  char * output;        /* structured output socket path, NULL disables */
   bool return_flag;     /* what's being returned */
 } yaml_t;
 
@@ -57,18 +103,36 @@ file_t create_file(char * filename, char *data);
 /* check if file exists */
 file_t file_check(char * filename);
 
-/* raise libnotify notification */
+/* bring up the persistent libnotify session */
+int notify_session_init(void);
+
+/* raise libnotify notification (rate-limited, coalescing) */
 void raise_notification(const char * timeinfo, const char *event);
 
+/* tear down the libnotify session */
+void notify_session_end(void);
+
 /* parse event correctly and return value*/
 uint32_t parse_event(char * event);
 
-/* get string of the event being caught */
-const char * get_event(struct inotify_event *i);
+/* compile a rule's filename pattern to its fastest matcher */
+void compile_pattern(rule_t * rule);
+
+/* test a filename against a rule's compiled pattern */
+bool match_pattern(rule_t * rule, const char * name);
+
+/* content digest of a file (0 on failure or empty file) */
+uint64_t hash_file(const char * path);
+
+/* get string of the event mask being caught */
+const char * get_event(uint32_t mask);
 
 /* time retrieval helper */
 struct tm * gettime(time_t rawtime);
 
+/* cached human-readable timestamp, refreshed at most once per second */
+const char * get_cached_time(void);
+
 /* parser for YAML configuration */
 yaml_t parse_yaml_config(char * filename);
 
@@ -29,6 +29,8 @@ void log_set_lock(log_LockFn fn);
 void log_set_fp(FILE *fp);
 void log_set_level(int level);
 void log_set_quiet(int enable);
+void log_set_buffered(int enable);
+void log_flush(void);
 
 void log_log(int level, const char *file, int line, const char *fmt, ...);
 
@@ -0,0 +1,29 @@
+#ifndef _REPORT_H
+#define _REPORT_H
+
+#include <stdbool.h>
+
+/* lines buffered before a forced writev flush */
+#define REPORT_MAX_BATCH   64
+
+/* max formatted bytes per report line */
+#define REPORT_LINE_LEN    320
+
+/* default latency bound when the config does not set one */
+#define REPORT_FLUSH_MS    10
+
+/* set up stdout reporting; interactive (tty) stdout stays unbuffered,
+ * a pipe gets writev batching with the given latency bound in ms
+ * (<= 0 picks the default) */
+void report_init(int flush_ms);
+
+/* report one event line; flushes on batch/latency bounds */
+void report_emit(const char * event, const char * path, int count);
+
+/* push out anything buffered */
+void report_flush(void);
+
+/* flush on exit */
+void report_shutdown(void);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _SINK_H
+#define _SINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* lines buffered before a forced writev flush */
+#define SINK_MAX_BATCH   64
+
+/* max formatted bytes per event line */
+#define SINK_LINE_LEN    320
+
+/* latency bound: flush at least this often while events trickle in */
+#define SINK_FLUSH_MS    10
+
+/* connect the structured output stream to a unix socket; 0 on success */
+int sink_init(char * path);
+
+/* whether a sink is connected and should replace stdout reporting */
+bool sink_active(void);
+
+/* buffer one event as a JSONL record; flushes on batch/latency bounds */
+void sink_emit(int wd, uint32_t mask, int count, const char * event, const char * name);
+
+/* push out anything buffered */
+void sink_flush(void);
+
+/* flush and disconnect */
+void sink_shutdown(void);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* identifies a fileguard watch-state snapshot */
+#define SNAPSHOT_MAGIC      0x46475353      /* "FGSS" */
+#define SNAPSHOT_VERSION    1
+
+/* snap_hdr_t struct: fixed header at the front of the snapshot file */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;      /* number of entries that follow */
+} snap_hdr_t;
+
+/* snap_entry_t struct: one registered watch worth restoring — which
+ * rule owned it, the path it covered, and the path's mtime at save
+ * time so startup can stat-scan for changes missed while down */
+typedef struct
+{
+    uint32_t rule;       /* index into the config's rule array */
+    int64_t mtime;       /* st_mtime when the snapshot was taken */
+    char * path;         /* watched path */
+} snap_entry_t;
+
+/* snapshot_t struct: a loaded snapshot; entry paths point into the
+ * underlying mapping, which stays alive until snapshot_close() */
+typedef struct
+{
+    void * map;
+    size_t map_len;
+    snap_entry_t * entries;
+    int count;
+} snapshot_t;
+
+/* write the watch table out as a snapshot; returns 0 on success */
+int snapshot_save(char * file, snap_entry_t * entries, int count);
+
+/* map and validate a snapshot; NULL if missing or malformed */
+snapshot_t * snapshot_load(char * file);
+
+/* release a loaded snapshot */
+void snapshot_close(snapshot_t * snap);
+
+#endif
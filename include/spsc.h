@@ -0,0 +1,45 @@
+#ifndef _SPSC_H
+#define _SPSC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <time.h>
+
+/* spsc_rec_t struct: one normalized event record handed from the
+ * reader stage to the dispatcher stage */
+typedef struct
+{
+    int wd;                    /* watch descriptor (or synthetic id) */
+    uint32_t mask;             /* inotify-style event mask */
+    struct timespec read_ts;   /* monotonic timestamp of the read() */
+    char name[NAME_MAX + 1];   /* filename / resolved path, or "" */
+} spsc_rec_t;
+
+/* spsc_t struct: lock-free single-producer/single-consumer ring.
+ * Producer owns tail, consumer owns head; the two live on separate
+ * cachelines so neither side bounces the other's line */
+typedef struct
+{
+    spsc_rec_t * slots;
+    size_t cap;                                  /* power of two */
+    _Atomic size_t head __attribute__ ((aligned(64)));   /* consumer */
+    _Atomic size_t tail __attribute__ ((aligned(64)));   /* producer */
+} spsc_t;
+
+/* allocate a ring with cap slots (rounded up to a power of two);
+ * returns 0 on success */
+int spsc_init(spsc_t * q, size_t cap);
+
+/* producer side: returns false when the ring is full */
+bool spsc_push(spsc_t * q, const spsc_rec_t * rec);
+
+/* consumer side: returns false when the ring is empty */
+bool spsc_pop(spsc_t * q, spsc_rec_t * rec);
+
+/* release the slot storage */
+void spsc_destroy(spsc_t * q);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <stdatomic.h>
+#include <time.h>
+
+/* counter blocks: slot 0 belongs to the reader and main thread, slots
+ * 1..N to the dispatcher shards. Each block sits on its own cacheline,
+ * so shards never bounce a counter line between cores */
+#define STATS_SHARDS_MAX 17
+
+/* stats_t struct: per-stage pipeline counters. Increments are relaxed
+ * atomics on a dedicated cacheline-aligned block, so instrumentation
+ * adds nothing measurable to the event loop */
+typedef struct
+{
+    _Atomic unsigned long events_read;      /* raw events parsed from the fd */
+    _Atomic unsigned long bytes_drained;    /* bytes pulled out of the kernel */
+    _Atomic unsigned long matches;          /* events matching a rule's mask */
+    _Atomic unsigned long actions_spawned;  /* jobs handed to the executor */
+    _Atomic unsigned long overflows;        /* IN_Q_OVERFLOW occurrences */
+    _Atomic unsigned long coalesced;        /* duplicates merged into a window */
+    _Atomic unsigned long watermark_hits;   /* kernel queue crossed 80% full */
+    _Atomic unsigned long suppressed;       /* duplicates dropped by the TTL cache */
+    _Atomic unsigned long unchanged;        /* actions skipped: content identical */
+    _Atomic unsigned long ring_dropped;     /* events lost to a full shard ring */
+} __attribute__ ((aligned(64))) stats_t;
+
+extern stats_t fg_stats[STATS_SHARDS_MAX];
+
+/* which counter block this thread bumps; dispatcher shards set their own */
+extern _Thread_local int stats_shard;
+
+/* relaxed increments: visible to the dumper, free on the hot path */
+#define STAT_INC(field) \
+    atomic_fetch_add_explicit(&fg_stats[stats_shard].field, 1, memory_order_relaxed)
+#define STAT_ADD(field, n) \
+    atomic_fetch_add_explicit(&fg_stats[stats_shard].field, (unsigned long) (n), memory_order_relaxed)
+
+/* hist_t struct: lock-free log2-bucket latency histogram. Bucket i
+ * holds samples in [2^i, 2^(i+1)) microseconds; recording is one
+ * relaxed increment, so it can sit on the hot path */
+#define HIST_BUCKETS 64
+
+typedef struct
+{
+    _Atomic unsigned long counts[HIST_BUCKETS];
+} hist_t;
+
+/* pipeline latency: kernel read -> rule match, and match -> spawn */
+extern hist_t fg_hist_read_match;
+extern hist_t fg_hist_match_spawn;
+
+/* record one latency sample, in nanoseconds */
+void stats_hist_record(hist_t * h, long ns);
+
+/* nanoseconds elapsed since a CLOCK_MONOTONIC timestamp */
+long stats_ns_since(const struct timespec * then);
+
+/* write the counters to a file descriptor (signal-safe: dprintf only) */
+void stats_dump(int fd);
+
+/* serve the counters over a unix socket at path; returns 0 on success */
+int stats_endpoint_init(char * path);
+
+/* stop the endpoint thread and unlink the socket */
+void stats_endpoint_shutdown(void);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * backend.c
+ *
+ *      fanotify backend. One FAN_MARK_FILESYSTEM mark covers an entire
+ *      mount with constant kernel memory, where inotify needs a watch
+ *      per directory. Records are translated to inotify-style masks so
+ *      the rule-dispatch surface is shared between backends.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+
+#include "log.h"
+#include "backend.h"
+
+
+int
+backend_from_name(const char * name)
+{
+    if (!strcmp(name, "inotify"))
+        return BACKEND_INOTIFY;
+    else if (!strcmp(name, "fanotify"))
+        return BACKEND_FANOTIFY;
+    return -1;
+}
+
+
+int
+fanotify_backend_init(void)
+{
+    /* nonblocking, like the inotify fd, so the epoll drain loop is shared */
+    int fan_fd = fanotify_init(FAN_CLASS_NOTIF | FAN_NONBLOCK, O_RDONLY);
+    if (fan_fd < 0)
+        log_warn("Could not initialize fanotify (requires CAP_SYS_ADMIN): %s",
+                 strerror(errno));
+    return fan_fd;
+}
+
+
+int
+fanotify_backend_mark(int fan_fd, char * path)
+{
+    uint64_t mask = FAN_ACCESS | FAN_MODIFY | FAN_OPEN | FAN_CLOSE;
+
+    if (fanotify_mark(fan_fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                      mask, AT_FDCWD, path) < 0) {
+        log_warn("Could not mark filesystem of %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    log_info("Marked filesystem of %s for fanotify", path);
+    return 0;
+}
+
+
+/* translate a fanotify mask to the inotify bits the rule masks use */
+static uint32_t
+fan_to_inotify(uint64_t mask)
+{
+    uint32_t out = 0;
+    if (mask & FAN_ACCESS)          out |= IN_ACCESS;
+    if (mask & FAN_MODIFY)          out |= IN_MODIFY;
+    if (mask & FAN_OPEN)            out |= IN_OPEN;
+    if (mask & FAN_CLOSE_WRITE)     out |= IN_CLOSE_WRITE;
+    if (mask & FAN_CLOSE_NOWRITE)   out |= IN_CLOSE_NOWRITE;
+    return out;
+}
+
+
+int
+fanotify_backend_next(char * buf, int len, int off, fan_event_t * out)
+{
+    struct fanotify_event_metadata *md =
+        (struct fanotify_event_metadata *) (buf + off);
+
+    if (off >= len || !FAN_EVENT_OK(md, (size_t) (len - off)))
+        return 0;
+
+    out->mask = fan_to_inotify(md->mask);
+    out->path[0] = '\0';
+
+    /* resolve the event's fd back to a path, then drop the fd */
+    if (md->fd >= 0) {
+        char link[64];
+        snprintf(link, sizeof(link), "/proc/self/fd/%i", md->fd);
+        ssize_t n = readlink(link, out->path, sizeof(out->path) - 1);
+        if (n > 0)
+            out->path[n] = '\0';
+        close(md->fd);
+    }
+
+    return md->event_len;
+}
@@ -0,0 +1,167 @@
+/*
+ * eventlog.c
+ *
+ *      Append-only, memory-mapped binary event log. One fd is held open
+ *      for the lifetime of the log and records are fixed-size slots in
+ *      a mmap'd ring, so sustained bursts cost memcpys rather than an
+ *      open/format/close per event.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "log.h"
+#include "eventlog.h"
+
+
+/* record area begins right after the header */
+static eventlog_rec_t *
+records(eventlog_t * log)
+{
+    return (eventlog_rec_t *) ((char *) log->map + sizeof(eventlog_hdr_t));
+}
+
+/* registry of open logs, keyed by path: every watch (and rule) logging
+ * to the same file shares one handle, one mapping and one lock */
+static eventlog_t *open_logs;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+eventlog_t *
+eventlog_open(char * path)
+{
+    size_t len = sizeof(eventlog_hdr_t) + EVENTLOG_CAPACITY * sizeof(eventlog_rec_t);
+
+    pthread_mutex_lock(&registry_lock);
+
+    /* already open: hand out the shared handle */
+    for (eventlog_t *l = open_logs; l != NULL; l = l->next) {
+        if (strcmp(l->path, path) == 0) {
+            l->refs++;
+            pthread_mutex_unlock(&registry_lock);
+            return l;
+        }
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        pthread_mutex_unlock(&registry_lock);
+        log_warn("Could not open event log %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    if (ftruncate(fd, len) < 0) {
+        pthread_mutex_unlock(&registry_lock);
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        pthread_mutex_unlock(&registry_lock);
+        close(fd);
+        return NULL;
+    }
+
+    eventlog_t *elog = malloc(sizeof(eventlog_t));
+    if (elog == NULL) {
+        pthread_mutex_unlock(&registry_lock);
+        munmap(map, len);
+        close(fd);
+        return NULL;
+    }
+
+    elog->fd = fd;
+    elog->map = map;
+    elog->map_len = len;
+    elog->last_sync = 0;
+    elog->path = strdup(path);
+    elog->refs = 1;
+    pthread_mutex_init(&elog->lock, NULL);
+    elog->next = open_logs;
+    open_logs = elog;
+
+    /* initialize the header, unless we reopened a valid existing log.
+     * The layout compiled into this binary is authoritative: a header
+     * with the right magic but a mismatched version or capacity would
+     * send appends past the mapping we just sized, so it is wiped */
+    eventlog_hdr_t *hdr = map;
+    if (hdr->magic != EVENTLOG_MAGIC
+            || hdr->version != EVENTLOG_VERSION
+            || hdr->capacity != EVENTLOG_CAPACITY) {
+        if (hdr->magic == EVENTLOG_MAGIC)
+            log_warn("Event log %s header mismatch (version %u, %u slots), reinitializing",
+                     path, hdr->version, hdr->capacity);
+        hdr->magic = EVENTLOG_MAGIC;
+        hdr->version = EVENTLOG_VERSION;
+        hdr->capacity = EVENTLOG_CAPACITY;
+        hdr->head = 0;
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+
+    log_info("Event log %s mapped (%zu bytes, %i slots)", path, len, EVENTLOG_CAPACITY);
+    return elog;
+}
+
+
+void
+eventlog_append(eventlog_t * log, int wd, uint32_t mask, int count, const char * name)
+{
+    eventlog_hdr_t *hdr = log->map;
+
+    /* different wds dispatch on different shards but may share this
+     * log, so slot claim and record write serialize on the handle */
+    pthread_mutex_lock(&log->lock);
+    eventlog_rec_t *rec = &records(log)[hdr->head % hdr->capacity];
+
+    rec->ts = (int64_t) time(NULL);
+    rec->wd = wd;
+    rec->mask = mask;
+    rec->count = count;
+    strncpy(rec->name, name, EVENTLOG_NAME_LEN - 1);
+    rec->name[EVENTLOG_NAME_LEN - 1] = '\0';
+
+    hdr->head++;
+
+    /* flush dirty pages on a coarse timer, not per record */
+    if (rec->ts - log->last_sync >= EVENTLOG_SYNC_SECS) {
+        msync(log->map, log->map_len, MS_ASYNC);
+        log->last_sync = rec->ts;
+    }
+    pthread_mutex_unlock(&log->lock);
+}
+
+
+void
+eventlog_close(eventlog_t * log)
+{
+    if (log == NULL)
+        return;
+
+    pthread_mutex_lock(&registry_lock);
+    if (--log->refs > 0) {
+        pthread_mutex_unlock(&registry_lock);
+        return;
+    }
+
+    /* last reference: unlink from the registry and tear down */
+    for (eventlog_t **pp = &open_logs; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == log) {
+            *pp = log->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    msync(log->map, log->map_len, MS_SYNC);
+    munmap(log->map, log->map_len);
+    close(log->fd);
+    pthread_mutex_destroy(&log->lock);
+    free(log->path);
+    free(log);
+}
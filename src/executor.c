@@ -0,0 +1,274 @@
+/*
+ * executor.c
+ *
+ *      Asynchronous action execution pool. The event loop enqueues
+ *      matched commands here and worker threads posix_spawn them
+ *      without a shell, so action latency never stalls event intake.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include "log.h"
+#include "stats.h"
+#include "executor.h"
+
+extern char **environ;
+
+/* job_t struct: one queued action, holding an inline copy of the command
+ * string with argv offsets split into it, plus the event context handed
+ * to the child. Jobs are plain values in the queue slots, so
+ * enqueue/dequeue never allocates */
+typedef struct
+{
+    char buf[EXECUTOR_CMD_LEN];       /* inline copy of the command string */
+    char * argv[EXECUTOR_MAX_ARGS];   /* argv split in-place from buf */
+    char path[EXECUTOR_PATH_LEN];     /* path the event fired on */
+    char event[24];                   /* inotify event name */
+    int wd;                           /* originating watch descriptor */
+    long when;                        /* epoch seconds at enqueue time */
+    struct timespec match_ts;         /* monotonic time of the rule match */
+    bool timed;                       /* match_ts is valid */
+} job_t;
+
+/* bounded circular job queue guarded by a mutex */
+static struct {
+    job_t jobs[EXECUTOR_QUEUE_LEN];
+    int head;
+    int tail;
+    int count;
+    bool running;
+    pthread_mutex_t lock;
+    pthread_cond_t nonempty;
+} queue;
+
+/* worker pool */
+static pthread_t workers[EXECUTOR_WORKERS];
+static int nworkers;
+
+
+/* split a command string in place into argv entries, honoring single and
+ * double quotes; returns the number of entries */
+static int
+split_args(char * buf, char ** argv)
+{
+    int argc = 0;
+    char *p = buf;
+
+    while (*p != '\0' && argc < EXECUTOR_MAX_ARGS - 1) {
+        /* skip leading whitespace */
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '\0')
+            break;
+
+        /* a quoted argument runs to the matching quote */
+        if (*p == '\'' || *p == '"') {
+            char quote = *p++;
+            argv[argc++] = p;
+            while (*p != '\0' && *p != quote)
+                p++;
+        } else {
+            argv[argc++] = p;
+            while (*p != '\0' && *p != ' ' && *p != '\t')
+                p++;
+        }
+
+        if (*p != '\0')
+            *p++ = '\0';
+    }
+
+    argv[argc] = NULL;
+    return argc;
+}
+
+
+/* environment template: a copy of environ with four extra slots for the
+ * FG_* variables, built once at init. Each worker clones the pointer
+ * vector and points the last four slots at its own value buffers, so
+ * per-job env setup is four snprintfs and zero allocations */
+static char **env_base;
+static int env_base_len;
+
+static char **
+clone_envp(char * ep, char * ee, char * ew, char * et)
+{
+    char **envp = malloc((env_base_len + 5) * sizeof(char *));
+    if (envp == NULL)
+        return NULL;
+
+    memcpy(envp, env_base, env_base_len * sizeof(char *));
+    envp[env_base_len] = ep;
+    envp[env_base_len + 1] = ee;
+    envp[env_base_len + 2] = ew;
+    envp[env_base_len + 3] = et;
+    envp[env_base_len + 4] = NULL;
+    return envp;
+}
+
+
+/* worker thread: pull jobs off the queue and spawn them */
+static void *
+worker_main(void * unused)
+{
+    /* this worker's reusable FG_* buffers, wired into its envp once */
+    char env_path[EXECUTOR_PATH_LEN + 16];
+    char env_event[40];
+    char env_wd[24];
+    char env_time[32];
+    char **envp = clone_envp(env_path, env_event, env_wd, env_time);
+    if (envp == NULL)
+        return NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&queue.lock);
+        while (queue.count == 0 && queue.running)
+            pthread_cond_wait(&queue.nonempty, &queue.lock);
+
+        if (queue.count == 0 && !queue.running) {
+            pthread_mutex_unlock(&queue.lock);
+            break;
+        }
+
+        job_t job = queue.jobs[queue.head];
+        queue.head = (queue.head + 1) % EXECUTOR_QUEUE_LEN;
+        queue.count--;
+        pthread_mutex_unlock(&queue.lock);
+
+        /* split here, so argv points into this worker's copy */
+        if (split_args(job.buf, job.argv) == 0)
+            continue;
+
+        /* event context into the environment */
+        snprintf(env_path, sizeof(env_path), "FG_PATH=%s", job.path);
+        snprintf(env_event, sizeof(env_event), "FG_EVENT=%s", job.event);
+        snprintf(env_wd, sizeof(env_wd), "FG_WD=%i", job.wd);
+        snprintf(env_time, sizeof(env_time), "FG_TIME=%li", job.when);
+
+        /* argv placeholder substitution: point, don't copy */
+        for (int i = 1; job.argv[i] != NULL; i++) {
+            if (job.argv[i][0] != '%' || job.argv[i][2] != '\0')
+                continue;
+            switch (job.argv[i][1]) {
+                case 'f': job.argv[i] = job.path; break;
+                case 'e': job.argv[i] = job.event; break;
+                case 'w': job.argv[i] = env_wd + 6; break;
+                case 't': job.argv[i] = env_time + 8; break;
+            }
+        }
+
+        /* spawn directly, no shell in between */
+        pid_t pid;
+        int rc = posix_spawnp(&pid, job.argv[0], NULL, NULL, job.argv, envp);
+        if (rc != 0)
+            log_warn("Could not spawn %s: %s", job.argv[0], strerror(rc));
+        else {
+            /* SLO instrumentation: rule match to child spawned */
+            if (job.timed)
+                stats_hist_record(&fg_hist_match_spawn,
+                                  stats_ns_since(&job.match_ts));
+            int status;
+            waitpid(pid, &status, 0);
+            if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
+                log_debug("Action %s exited with status %i",
+                          job.argv[0], WEXITSTATUS(status));
+        }
+    }
+
+    free(envp);
+    return NULL;
+}
+
+
+int
+executor_init(int workers_wanted)
+{
+    /* snapshot the inherited environment once for the envp templates */
+    env_base_len = 0;
+    while (environ[env_base_len] != NULL)
+        env_base_len++;
+    env_base = environ;
+
+    queue.head = queue.tail = queue.count = 0;
+    queue.running = true;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.nonempty, NULL);
+
+    if (workers_wanted <= 0 || workers_wanted > EXECUTOR_WORKERS)
+        workers_wanted = EXECUTOR_WORKERS;
+
+    for (nworkers = 0; nworkers < workers_wanted; nworkers++) {
+        if (pthread_create(&workers[nworkers], NULL, worker_main, NULL) != 0)
+            return -1;
+    }
+
+    log_debug("Executor started with %i worker(s)", nworkers);
+    return 0;
+}
+
+
+int
+executor_submit(const char * command, const char * path,
+                const char * event, int wd,
+                const struct timespec * match_ts)
+{
+    if (strlen(command) >= EXECUTOR_CMD_LEN) {
+        log_warn("Command too long, dropping: %s", command);
+        return -1;
+    }
+
+    /* a truncated path would hand the hook a FG_PATH/%f pointing at a
+     * file that does not exist: drop the job instead */
+    if (path != NULL && strlen(path) >= EXECUTOR_PATH_LEN) {
+        log_warn("Event path too long, dropping action for: %s", path);
+        return -1;
+    }
+
+    pthread_mutex_lock(&queue.lock);
+    if (queue.count == EXECUTOR_QUEUE_LEN) {
+        /* never block the event loop: drop and report instead */
+        pthread_mutex_unlock(&queue.lock);
+        log_warn("Action queue full, dropping: %s", command);
+        return -1;
+    }
+
+    /* copy straight into the queue slot: no allocation on this path */
+    job_t *job = &queue.jobs[queue.tail];
+    strcpy(job->buf, command);
+    snprintf(job->path, sizeof(job->path), "%s", path ? path : "");
+    snprintf(job->event, sizeof(job->event), "%s", event ? event : "");
+    job->wd = wd;
+    job->when = (long) time(NULL);
+    job->timed = (match_ts != NULL);
+    if (job->timed)
+        job->match_ts = *match_ts;
+    queue.tail = (queue.tail + 1) % EXECUTOR_QUEUE_LEN;
+    queue.count++;
+    pthread_cond_signal(&queue.nonempty);
+    pthread_mutex_unlock(&queue.lock);
+
+    return 0;
+}
+
+
+void
+executor_shutdown(void)
+{
+    pthread_mutex_lock(&queue.lock);
+    if (!queue.running) {
+        pthread_mutex_unlock(&queue.lock);
+        return;
+    }
+    queue.running = false;
+    pthread_cond_broadcast(&queue.nonempty);
+    pthread_mutex_unlock(&queue.lock);
+
+    for (int i = 0; i < nworkers; i++)
+        pthread_join(workers[i], NULL);
+    nworkers = 0;
+}
@@ -18,41 +18,220 @@ check_inode_permissions(char * inode_name)
 }
 
 
-void
-raise_notification(const char * timeinfo, const char *event)
+/* persistent libnotify session: one D-Bus connection and one reused
+ * notification object for the process lifetime, instead of a full
+ * connect/disconnect round-trip per event */
+static NotifyNotification * session_display;
+
+/* rate limiting: at most one bubble per window; everything else is
+ * counted and summarized in the next one. The lock serializes the
+ * window state and the shared notification object: with sharded
+ * dispatch every shard calls in here, and neither libnotify nor the
+ * counters tolerate that unsynchronized */
+#define NOTIFY_WINDOW_SECS 5
+static time_t last_shown;
+static unsigned long suppressed;
+static pthread_mutex_t notify_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int
+notify_session_init(void)
 {
     gboolean nint;
     nint = notify_init("fileguard");
-    if (nint == FALSE)
+    if (nint == FALSE) {
         perror("Could not initialize libnotify. Reason");
+        return -1;
+    }
 
-    /* instantiate notification display with time and event */
-    NotifyNotification * display = notify_notification_new(timeinfo, event, NULL);
-    if (display == NULL)
+    session_display = notify_notification_new("fileguard", NULL, NULL);
+    if (session_display == NULL) {
         perror("Could not initiailize display. Reason");
+        return -1;
+    }
 
-    /* display, and destroy */
-    notify_notification_show(display, NULL);
+    return 0;
+}
+
+
+void
+raise_notification(const char * timeinfo, const char *event)
+{
+    if (session_display == NULL)
+        return;
+
+    pthread_mutex_lock(&notify_lock);
+
+    /* inside the window: count it into the next bubble instead of
+     * queueing another D-Bus round-trip */
+    time_t now = time(NULL);
+    if (now - last_shown < NOTIFY_WINDOW_SECS) {
+        suppressed++;
+        pthread_mutex_unlock(&notify_lock);
+        return;
+    }
+
+    if (suppressed > 0) {
+        char body[96];
+        snprintf(body, sizeof(body), "%s (+%lu more events in the last %i s)",
+                 event, suppressed, NOTIFY_WINDOW_SECS);
+        notify_notification_update(session_display, timeinfo, body, NULL);
+    } else {
+        notify_notification_update(session_display, timeinfo, event, NULL);
+    }
+
+    notify_notification_show(session_display, NULL);
+    last_shown = now;
+    suppressed = 0;
+    pthread_mutex_unlock(&notify_lock);
+}
+
+
+void
+notify_session_end(void)
+{
+    if (session_display == NULL)
+        return;
+
+    session_display = NULL;
     notify_uninit();
 }
 
 
+uint32_t
+parse_event(char * event)
+{
+    if (!strcmp(event, "IN_ACCESS"))              return IN_ACCESS;
+    else if (!strcmp(event, "IN_ATTRIB"))         return IN_ATTRIB;
+    else if (!strcmp(event, "IN_CLOSE_WRITE"))    return IN_CLOSE_WRITE;
+    else if (!strcmp(event, "IN_CLOSE_NOWRITE"))  return IN_CLOSE_NOWRITE;
+    else if (!strcmp(event, "IN_CREATE"))         return IN_CREATE;
+    else if (!strcmp(event, "IN_DELETE"))         return IN_DELETE;
+    else if (!strcmp(event, "IN_DELETE_SELF"))    return IN_DELETE_SELF;
+    else if (!strcmp(event, "IN_MODIFY"))         return IN_MODIFY;
+    else if (!strcmp(event, "IN_MOVE_SELF"))      return IN_MOVE_SELF;
+    else if (!strcmp(event, "IN_MOVED_FROM"))     return IN_MOVED_FROM;
+    else if (!strcmp(event, "IN_MOVED_TO"))       return IN_MOVED_TO;
+    else if (!strcmp(event, "IN_OPEN"))           return IN_OPEN;
+    else if (!strcmp(event, "IN_UNMOUNT"))        return IN_UNMOUNT;
+
+    /* unknown event name */
+    return 0;
+}
+
+
+/* pattern compilation: most real-world filters are "*.ext", "name*" or a
+ * literal name, so those are classified once at load time and matched with
+ * a memcmp on the hot path; anything fancier falls back to fnmatch */
+void
+compile_pattern(rule_t * rule)
+{
+    if (rule->pattern == NULL) {
+        rule->match_kind = MATCH_ALL;
+        return;
+    }
+
+    char *pat = rule->pattern;
+    size_t len = strlen(pat);
+    size_t specials = strcspn(pat, "*?[");
+
+    if (specials == len) {
+        /* no glob characters at all: literal filename */
+        rule->match_kind = MATCH_EXACT;
+        rule->match_lit = pat;
+        rule->match_len = len;
+    } else if (pat[0] == '*' && strcspn(pat + 1, "*?[") == len - 1) {
+        /* single leading star: suffix match */
+        rule->match_kind = MATCH_SUFFIX;
+        rule->match_lit = pat + 1;
+        rule->match_len = len - 1;
+    } else if (specials == len - 1 && pat[len - 1] == '*') {
+        /* single trailing star: prefix match */
+        rule->match_kind = MATCH_PREFIX;
+        rule->match_lit = pat;
+        rule->match_len = len - 1;
+    } else {
+        rule->match_kind = MATCH_GLOB;
+    }
+}
+
+
+bool
+match_pattern(rule_t * rule, const char * name)
+{
+    /* events on the watched inode itself carry no name; the pattern only
+     * constrains directory children */
+    if (name[0] == '\0')
+        return true;
+
+    switch (rule->match_kind) {
+        case MATCH_ALL:
+            return true;
+        case MATCH_EXACT:
+            return strcmp(name, rule->match_lit) == 0;
+        case MATCH_PREFIX:
+            return strncmp(name, rule->match_lit, rule->match_len) == 0;
+        case MATCH_SUFFIX: {
+            size_t nlen = strlen(name);
+            return nlen >= rule->match_len &&
+                   memcmp(name + nlen - rule->match_len, rule->match_lit,
+                          rule->match_len) == 0;
+        }
+        default:
+            return fnmatch(rule->pattern, name, 0) == 0;
+    }
+}
+
+
 const char *
-get_event(struct inotify_event *i)
+get_event(uint32_t mask)
+{
+    if (mask & IN_ACCESS)                return "IN_ACCESS";
+    else if (mask & IN_ATTRIB)           return "IN_ATTRIB";
+    else if (mask & IN_CLOSE_WRITE)      return "IN_CLOSE_WRITE";
+    else if (mask & IN_CLOSE_NOWRITE)    return "IN_CLOSE_NOWRITE";
+    else if (mask & IN_CREATE)           return "IN_CREATE";
+    else if (mask & IN_DELETE)           return "IN_DELETE";
+    else if (mask & IN_DELETE_SELF)      return "IN_DELETE_SELF";
+    else if (mask & IN_MODIFY)           return "IN_MODIFY";
+    else if (mask & IN_MOVE_SELF)        return "IN_MOVE_SELF";
+    else if (mask & IN_MOVED_FROM)       return "IN_MOVED_FROM";
+    else if (mask & IN_MOVED_TO)         return "IN_MOVED_TO";
+    else if (mask & IN_OPEN)             return "IN_OPEN";
+    else if (mask & IN_UNMOUNT)          return "IN_UNMOUNT";
+    else if (mask & IN_Q_OVERFLOW)       return "IN_Q_OVERFLOW";
+    else                                 return "IN_UNKNOWN";
+}
+
+
+/* FNV-1a over the whole file via mmap, the same read path file_check()
+ * uses for the config. Fast enough that hashing a rewrite is orders of
+ * magnitude cheaper than running an action on unchanged content */
+uint64_t
+hash_file(const char * path)
 {
-    if (i->mask & IN_ACCESS)                return "IN_ACCESS";
-    else if (i->mask & IN_ATTRIB)           return "IN_ATTRIB";
-    else if (i->mask & IN_CLOSE_WRITE)      return "IN_CLOSE_WRITE";
-    else if (i->mask & IN_CLOSE_NOWRITE)    return "IN_CLOSE_NOWRITE";
-    else if (i->mask & IN_CREATE)           return "IN_CREATE";
-    else if (i->mask & IN_DELETE)           return "IN_DELETE";
-    else if (i->mask & IN_DELETE_SELF)      return "IN_DELETE_SELF";
-    else if (i->mask & IN_MODIFY)           return "IN_MODIFY";
-    else if (i->mask & IN_MOVE_SELF)        return "IN_MOVE_SELF";
-    else if (i->mask & IN_MOVED_FROM)       return "IN_MOVED_FROM";
-    else if (i->mask & IN_MOVED_TO)         return "IN_MOVED_TO";
-    else if (i->mask & IN_OPEN)             return "IN_OPEN";
-    else if (i->mask & IN_UNMOUNT)          return "IN_UNMOUNT";
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    unsigned char *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+
+    uint64_t h = 14695981039346656037ull;
+    for (off_t i = 0; i < st.st_size; i++) {
+        h ^= data[i];
+        h *= 1099511628211ull;
+    }
+
+    munmap(data, st.st_size);
+    return h;
 }
 
 
@@ -113,6 +292,30 @@ gettime(time_t rawtime)
 }
 
 
+/* clock cache: localtime/asctime do TZ lookups and are measurably hot
+ * when called per event, so the formatted string is refreshed at most
+ * once per second off the coarse kernel clock. Per thread, so one
+ * dispatcher shard can never hand out a string another is rewriting */
+static _Thread_local time_t cached_sec = -1;
+static _Thread_local char cached_str[26];
+
+const char *
+get_cached_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+
+    if (ts.tv_sec != cached_sec) {
+        struct tm tmv;
+        cached_sec = ts.tv_sec;
+        localtime_r(&cached_sec, &tmv);
+        asctime_r(&tmv, cached_str);
+    }
+
+    return cached_str;
+}
+
+
 yaml_t
 parse_yaml_config(char * filename)
 {
@@ -121,63 +324,208 @@ parse_yaml_config(char * filename)
 
     /* initialize tokenizer for yaml */
     int state = 0;
-    char **datap;
+    char **datap = NULL;
+    bool *flagp = NULL;
+    int *intp = NULL;
     char *tk;
 
+    /* rule currently being filled in */
+    rule_t *rule = NULL;
+
     /* initialize new yaml_t config */
     yaml_t config;
-    if (!yaml_parser_initialize(&parser)) {
-        config.return_flag = false;
+    memset(&config, 0, sizeof(config));
+
+    /* slurp the file: libyaml scans it from memory, and the size bounds
+     * the arena up front (strings never exceed the file, and there can
+     * be at most one rule per line) */
+    FILE *fptr = fopen(filename, "r");
+    if (fptr == NULL)
+        return config;
+
+    fseek(fptr, 0, SEEK_END);
+    long fsize = ftell(fptr);
+    rewind(fptr);
+    if (fsize <= 0) {
+        fclose(fptr);
         return config;
     }
 
-    /* initialize file for reading */
-    FILE *fptr = fopen(filename, "r");
-    if (fptr == NULL) {
-        config.return_flag = false;
+    unsigned char *text = malloc(fsize);
+    if (text == NULL || fread(text, 1, fsize, fptr) != (size_t) fsize) {
+        free(text);
+        fclose(fptr);
+        return config;
+    }
+    fclose(fptr);
+
+    int max_rules = 2;
+    for (long i = 0; i < fsize; i++)
+        if (text[i] == '\n')
+            max_rules++;
+
+    /* one contiguous allocation: the flat rule array at the base, every
+     * string bump-allocated behind it. Rule iteration at dispatch time
+     * is cache-linear and teardown/reload is a single free */
+    size_t pool_len = max_rules * sizeof(rule_t) + fsize + 64;
+    char *pool = calloc(1, pool_len);
+    if (pool == NULL) {
+        free(text);
+        return config;
+    }
+
+    rule_t *rules = (rule_t *) pool;
+    char *sp = pool + max_rules * sizeof(rule_t);
+    char *sp_end = pool + pool_len;
+
+    if (!yaml_parser_initialize(&parser)) {
+        free(pool);
+        free(text);
         return config;
     }
 
-    /* set input file */
-    yaml_parser_set_input_file(&parser, fptr);
+    yaml_parser_set_input_string(&parser, text, fsize);
+    memset(&token, 0, sizeof(token));
+
+    for (;;) {
+        if (!yaml_parser_scan(&parser, &token))
+            goto fail;
 
-    do {
-        yaml_parser_scan(&parser, &token);
-        switch (token.type) {
+        yaml_token_type_t type = token.type;
+        switch (type) {
             case YAML_KEY_TOKEN:
                 state = 0;
                 break;
             case YAML_VALUE_TOKEN:
                 state = 1;
                 break;
+            case YAML_BLOCK_ENTRY_TOKEN:
+                /* each `- ...` entry under the watch list starts a new rule */
+                if (config.nrules == max_rules)
+                    goto fail;
+                rule = &rules[config.nrules++];
+                break;
             case YAML_SCALAR_TOKEN:
                 tk = token.data.scalar.value;
 
                 if (state == 0) {
+                    flagp = NULL;
+                    intp = NULL;
+
+                    /* `watch` introduces the rule list, but carries no value */
+                    if (!strcmp(tk, "watch")) {
+                        datap = NULL;
+                        break;
+                    }
+
+                    /* top-level settings that do not belong to any rule */
+                    if (!strcmp(tk, "coalesce")) {
+                        datap = NULL;
+                        intp = &config.coalesce_ms;
+                        break;
+                    }
+                    if (!strcmp(tk, "queue")) {
+                        datap = NULL;
+                        intp = &config.queue_events;
+                        break;
+                    }
+                    if (!strcmp(tk, "suppress")) {
+                        datap = NULL;
+                        intp = &config.suppress_ms;
+                        break;
+                    }
+                    if (!strcmp(tk, "shards")) {
+                        datap = NULL;
+                        intp = &config.shards;
+                        break;
+                    }
+                    if (!strcmp(tk, "flush")) {
+                        datap = NULL;
+                        intp = &config.flush_ms;
+                        break;
+                    }
+                    if (!strcmp(tk, "backend")) {
+                        datap = &config.backend;
+                        break;
+                    }
+                    if (!strcmp(tk, "snapshot")) {
+                        datap = &config.snapshot;
+                        break;
+                    }
+                    if (!strcmp(tk, "stats")) {
+                        datap = &config.stats;
+                        break;
+                    }
+                    if (!strcmp(tk, "output")) {
+                        datap = &config.output;
+                        break;
+                    }
+
+                    /* a bare top-level key (legacy single-rule config) still
+                     * needs a rule to write into */
+                    if (rule == NULL) {
+                        if (config.nrules == max_rules)
+                            goto fail;
+                        rule = &rules[config.nrules++];
+                    }
+
                     if (!strcmp(tk, "inode"))
-                        datap = &config.inode;
+                        datap = &rule->inode;
                     else if (!strcmp(tk, "event"))
-                        datap = &config.event;
+                        datap = &rule->event;
                     else if (!strcmp(tk, "action"))
-                        datap = &config.action;
+                        datap = &rule->action;
+                    else if (!strcmp(tk, "pattern"))
+                        datap = &rule->pattern;
+                    else if (!strcmp(tk, "recursive")) {
+                        datap = NULL;
+                        flagp = &rule->recursive;
+                    }
+                    else if (!strcmp(tk, "if-changed")) {
+                        datap = NULL;
+                        flagp = &rule->if_changed;
+                    }
                     else {
-                        config.return_flag = false;
-                        return config;
+                        /* schema violation: an unknown key */
+                        goto fail;
                     }
-                } else {
-                    *datap = strdup(tk);
+                } else if (intp != NULL) {
+                    *intp = atoi(tk);
+                } else if (flagp != NULL) {
+                    *flagp = (!strcmp(tk, "true") || !strcmp(tk, "yes"));
+                } else if (datap != NULL) {
+                    /* bump-allocate the value string out of the pool */
+                    size_t len = strlen(tk) + 1;
+                    if (sp + len > sp_end)
+                        goto fail;
+                    memcpy(sp, tk, len);
+                    *datap = sp;
+                    sp += len;
                 }
                 break;
             default:
                 break;
         }
-    } while (token.type != YAML_STREAM_END_TOKEN);
+
+        yaml_token_delete(&token);
+        if (type == YAML_STREAM_END_TOKEN)
+            break;
+    }
 
     /* cleanup */
-    yaml_token_delete(&token);
     yaml_parser_delete(&parser);
-    fclose(fptr);
+    free(text);
 
+    config.pool = pool;
+    config.rules = rules;
     config.return_flag = true;
     return config;
+
+fail:
+    yaml_token_delete(&token);
+    yaml_parser_delete(&parser);
+    free(pool);
+    free(text);
+    memset(&config, 0, sizeof(config));
+    return config;
 }
@@ -25,17 +25,33 @@
 #include <stdarg.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
 
 #include "log.h"
 
+/* buffered sink tuning: lines accumulate in a growable buffer and hit
+ * the fd in batches instead of a write+flush per message */
+#define LOG_LINE_LEN   512
+#define LOG_BUF_FLUSH  (16 * 1024)
+#define LOG_FLUSH_MS   100
+
 static struct {
   void *udata;
   log_LockFn lock;
   FILE *fp;
   int level;
   int quiet;
+  int buffered;
+  char *buf;
+  size_t cap;
+  size_t len;
+  struct timespec last_flush;
 } L;
 
+static pthread_mutex_t buf_lock = PTHREAD_MUTEX_INITIALIZER;
+
 
 static const char *level_names[] = {
   "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
@@ -87,11 +103,114 @@ void log_set_quiet(int enable) {
 }
 
 
+void log_set_buffered(int enable) {
+  L.buffered = enable ? 1 : 0;
+  if (enable) {
+    clock_gettime(CLOCK_MONOTONIC, &L.last_flush);
+  }
+}
+
+
+/* push the accumulated buffer to stderr in one write; caller holds buf_lock */
+static void flush_locked(void) {
+  if (L.len > 0) {
+    if (write(STDERR_FILENO, L.buf, L.len) < 0) {
+      /* stderr gone: nothing sane to do but drop */
+    }
+    L.len = 0;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &L.last_flush);
+}
+
+
+void log_flush(void) {
+  pthread_mutex_lock(&buf_lock);
+  flush_locked();
+  pthread_mutex_unlock(&buf_lock);
+}
+
+
+/* append one formatted line to the growable write buffer and flush on
+ * the size/interval thresholds, or immediately for WARN and above */
+static void buffered_emit(int level, const char *line, size_t n) {
+  pthread_mutex_lock(&buf_lock);
+
+  if (L.len + n > L.cap) {
+    size_t cap = L.cap ? L.cap * 2 : LOG_BUF_FLUSH;
+    while (cap < L.len + n) {
+      cap *= 2;
+    }
+    char *grown = realloc(L.buf, cap);
+    if (grown == NULL) {
+      /* out of memory: fall back to a direct writev of this line */
+      flush_locked();
+      struct iovec iov = { (void *) line, n };
+      if (writev(STDERR_FILENO, &iov, 1) < 0) { /* dropped */ }
+      pthread_mutex_unlock(&buf_lock);
+      return;
+    }
+    L.buf = grown;
+    L.cap = cap;
+  }
+
+  memcpy(L.buf + L.len, line, n);
+  L.len += n;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long ms = (now.tv_sec - L.last_flush.tv_sec) * 1000
+          + (now.tv_nsec - L.last_flush.tv_nsec) / 1000000;
+
+  if (level >= LOG_WARN || L.len >= LOG_BUF_FLUSH || ms >= LOG_FLUSH_MS) {
+    flush_locked();
+  }
+
+  pthread_mutex_unlock(&buf_lock);
+}
+
+
 void log_log(int level, const char *file, int line, const char *fmt, ...) {
   if (level < L.level) {
     return;
   }
 
+  /* Buffered sink: format the whole line into a thread-local buffer and
+   * hand it to the batching path. No time()/localtime() per call -- the
+   * prefix timestamp is re-rendered only when the second changes */
+  if (L.buffered && !L.quiet && L.fp == NULL) {
+    static __thread char msg[LOG_LINE_LEN];
+    static __thread time_t ts_sec = -1;
+    static __thread char ts_buf[16];
+
+    time_t t = time(NULL);
+    if (t != ts_sec) {
+      struct tm lt;
+      localtime_r(&t, &lt);
+      ts_buf[strftime(ts_buf, sizeof(ts_buf), "%H:%M:%S", &lt)] = '\0';
+      ts_sec = t;
+    }
+
+#ifdef LOG_USE_COLOR
+    int n = snprintf(msg, sizeof(msg), "%s %s%-5s\x1b[0m \x1b[90m%s:%d:\x1b[0m ",
+                     ts_buf, level_colors[level], level_names[level], file, line);
+#else
+    int n = snprintf(msg, sizeof(msg), "%s %-5s %s:%d: ",
+                     ts_buf, level_names[level], file, line);
+#endif
+
+    va_list args;
+    va_start(args, fmt);
+    n += vsnprintf(msg + n, sizeof(msg) - n - 1, fmt, args);
+    va_end(args);
+    if ((size_t) n > sizeof(msg) - 2) {
+      n = sizeof(msg) - 2;
+    }
+    msg[n++] = '\n';
+
+    buffered_emit(level, msg, n);
+    return;
+  }
+
   /* Acquire lock */
   lock();
 
@@ -5,87 +5,1357 @@
  */
 #include "log.h"
 #include "fileguard.h"
+#include "executor.h"
+#include "eventlog.h"
+#include "arena.h"
+#include "backend.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "spsc.h"
+#include "sink.h"
+#include "report.h"
 
 /* used for signal handling */
 static volatile sig_atomic_t sc = true;
 
-/* global file and watch descriptors to be cleaned up */
-static int fd, wd;
-
-/* represents an array filled with events for watching */
-static const char *
-events[] =
-{
-   "IN_ACCESS",             // File accessed
-   "IN_ATTRIB",             // Metadata changes
-   "IN_CLOSE_WRITE",        // File opened for writing was closed.
-   "IN_CLOSE_NOWRITE",      // File or directory not opened for writing was closed.
-   "IN_CREATE",             // File/directory created
-   "IN_DELETE",             // File/directory deleted
-   "IN_DELETE_SELF",        // Watched inode deleted
-   "IN_MODIFY",             // File modified
-   "IN_MOVE_SELF",          // Watched inode moved
-   "IN_MOVED_FROM",         // Directory with old filename when a file is renamed.
-   "IN_MOVED_TO",           // Directory with new filename when a file is renamed.
-   "IN_OPEN",               // File/directory is opened
-   "IN_UNMOUNT",            // Filesystem unmounted
-};
+/* SIGHUP: re-read the config on the dispatcher's next pass */
+static volatile sig_atomic_t reload_pending;
 
+/* config file in use, kept for hot reloads */
+static char *yaml_target;
+
+/* global file descriptor to be cleaned up */
+static int fd;
+
+/* watch_t struct: maps a kernel watch descriptor back to the rule that
+ * registered it, with the action pre-tokenized at startup */
+typedef struct
+{
+    int wd;               /* watch descriptor handed back by inotify */
+    rule_t * rule;        /* rule this watch services */
+    char * path;          /* directory/file this watch covers */
+    char * prepend;       /* action verb: execute / log */
+    char * command;       /* action argument: command string or log path */
+    eventlog_t * elog;    /* open ring log for `log` actions, else NULL */
+} watch_t;
+
+/* wd->rule table serviced by the single inotify fd */
+static watch_t *watches;
+static int nwatches;
+
+/* flat index from watch descriptor to slot in watches[]. inotify hands
+ * out small dense wds, so dispatch is one array load plus a mask test
+ * no matter how many rules are live; -1 marks an unused wd */
+static int *wd_index;
+static int wd_index_len;
+
+/* runtime flags shared with the dispatcher */
+static int notifier;
+static int verbose;
+
+/* which kernel notification API is feeding the loop */
+static int backend_kind = BACKEND_INOTIFY;
+
+/* daemon mode: detach, supervise, restart the worker on crash */
+static int daemonized;
+static pid_t worker_pid;
+
+/* parsed configuration; file-scope so shutdown can snapshot against it */
+static yaml_t y;
+
+/* coalescing window in ms; 0 dispatches every raw event */
+static int coalesce_ms;
+
+static void catch_sig(int s);
+
+/* duplicate-suppression TTL in ms; 0 disables the cache */
+static int suppress_ms;
+
+/* pend_t struct: a logical event accumulating duplicates until its
+ * coalescing window closes */
+typedef struct
+{
+    bool used;
+    int wd;                    /* originating watch descriptor */
+    char name[NAME_MAX + 1];   /* filename within the watch, or "" */
+    uint32_t mask;             /* union of all masks seen in the window */
+    int count;                 /* raw events merged into this entry */
+    struct timespec first;     /* when the window opened */
+    struct timespec read_ts;   /* read timestamp of the first raw event */
+} pend_t;
+
+/* fixed-size pending table; collisions and overflow dispatch immediately */
+#define PENDING_MAX 1024
+
+/* supp_t struct: one recently-seen (wd, name, mask) tuple in the
+ * suppression cache */
+typedef struct
+{
+    bool used;
+    int wd;
+    uint32_t mask;
+    char name[NAME_MAX + 1];
+    struct timespec seen;      /* when this tuple last fired */
+} supp_t;
+
+/* fixed-size open-addressed suppression cache. Unlike coalescing, which
+ * merges a burst and still dispatches it, this drops known-noisy
+ * repeats (editor swap-file churn and the like) outright for the TTL */
+#define SUPPRESS_MAX 512
+
+/* digest_t struct: last-seen content hash of a file, for rules that
+ * only act when a close-write actually changed something */
+typedef struct
+{
+    bool used;
+    int wd;
+    char name[NAME_MAX + 1];
+    uint64_t hash;
+} digest_t;
+
+/* fixed-size open-addressed digest cache per shard */
+#define DIGEST_MAX 512
+
+/* per-dispatcher ring capacity */
+#define EVENT_RING_LEN 8192
+
+/* per-drain-cycle scratch memory: reset in O(1) when a shard goes idle,
+ * so event-time string building never hits malloc */
+#define SCRATCH_ARENA_LEN (256 * 1024)
+
+/* shard_t struct: everything one dispatcher thread owns privately. An
+ * event's wd picks its shard, so per-file ordering holds while shards
+ * process independent files in parallel without sharing state */
+typedef struct
+{
+    spsc_t q;                      /* reader -> this shard handoff ring */
+    arena_t scratch;               /* shard-local scratch arena */
+    pend_t pending[PENDING_MAX];   /* shard-local coalescing table */
+    int npending;
+    supp_t suppress[SUPPRESS_MAX]; /* shard-local suppression cache */
+    digest_t digests[DIGEST_MAX];  /* shard-local content-hash cache */
+    pthread_t thread;
+} shard_t;
+
+#define SHARDS_MAX 16
+static shard_t *shards;
+static int nshards = 1;
+
+/* guards the wd->rule table: shards read per event, watch registration
+ * and hot reload write. Uncontended read locks keep the fast path fast */
+static pthread_rwlock_t table_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* kernel queue capacity in events, probed (and optionally raised) from
+ * /proc/sys/fs/inotify at startup; sizes the drain buffer and the
+ * saturation watermark */
+static int queue_limit_events = 16384;
+
+
+/* read one integer sysctl from /proc/sys/fs/inotify */
+static int
+read_inotify_limit(const char * name)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "/proc/sys/fs/inotify/%s", name);
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+
+    int val = -1;
+    if (fscanf(fp, "%i", &val) != 1)
+        val = -1;
+    fclose(fp);
+    return val;
+}
+
+
+/* probe the host's inotify limits, and when the config asked for a
+ * larger queue than the kernel default, try to raise it (needs root;
+ * failure just means we run against the smaller queue) */
+static void
+probe_inotify_limits(void)
+{
+    int queued = read_inotify_limit("max_queued_events");
+    int watches_limit = read_inotify_limit("max_user_watches");
+
+    if (y.queue_events > 0 && y.queue_events > queued) {
+        FILE *fp = fopen("/proc/sys/fs/inotify/max_queued_events", "w");
+        if (fp != NULL && fprintf(fp, "%i\n", y.queue_events) > 0)
+            queued = read_inotify_limit("max_queued_events");
+        else
+            log_warn("Could not raise max_queued_events to %i (need root); "
+                     "staying at %i", y.queue_events, queued);
+        if (fp != NULL)
+            fclose(fp);
+    }
+
+    if (queued > 0)
+        queue_limit_events = queued;
+
+    log_info("inotify limits: max_queued_events=%i max_user_watches=%i",
+             queued, watches_limit);
+}
 
 /* displays help menu */
 static void
 usage(char * application_name)
 {
     /* print help to STDOUT */
-    fprintf(stdout, "Usage: (note that these are optional arguments)\n\n\t %s -[h|v|n] <other.yaml>\n\n"
+    fprintf(stdout, "Usage: (note that these are optional arguments)\n\n\t %s -[h|v|n|d] <other.yaml>\n\n"
             "-h : Display this help message\n"
             "-v : Turns ON verbosity\n"
             "-n : Turns ON libnotify notifications\n"
+            "-d : Run as a supervised daemon\n"
             , application_name);
 }
 
 
+/* look up the watch entry for a watch descriptor returned by the kernel */
+static watch_t *
+find_watch(int wd)
+{
+    if (wd < 0 || wd >= wd_index_len || wd_index[wd] < 0)
+        return NULL;
+    return &watches[wd_index[wd]];
+}
+
+
+/* record a wd->slot mapping, growing the index as wds get denser */
+static void
+index_watch(int wd, int slot)
+{
+    if (wd >= wd_index_len) {
+        int grown_len = (wd_index_len == 0) ? 64 : wd_index_len;
+        while (grown_len <= wd)
+            grown_len *= 2;
+
+        int *grown = realloc(wd_index, grown_len * sizeof(int));
+        if (grown == NULL) {
+            perror("malloc failed. Reason");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = wd_index_len; i < grown_len; i++)
+            grown[i] = -1;
+
+        wd_index = grown;
+        wd_index_len = grown_len;
+    }
+
+    wd_index[wd] = slot;
+}
+
+
+/* append an entry to the wd->rule table, growing the table as needed.
+ * Shared by both backends: inotify entries carry a kernel wd, fanotify
+ * entries a synthetic one */
+static watch_t *
+append_watch(int wd, rule_t * rule, char * path, char * prepend, char * command)
+{
+    watch_t *grown = realloc(watches, (nwatches + 1) * sizeof(watch_t));
+    if (grown == NULL) {
+        perror("malloc failed. Reason");
+        exit(EXIT_FAILURE);
+    }
+    watches = grown;
+
+    watch_t *w = &watches[nwatches++];
+    w->wd = wd;
+    w->rule = rule;
+    w->path = strdup(path);
+    w->prepend = prepend;
+    w->command = command;
+
+    /* a log action gets its ring log mapped once, up front */
+    w->elog = NULL;
+    if (strcmp(prepend, "log") == 0) {
+        w->elog = eventlog_open(command);
+        if (w->elog == NULL)
+            log_warn("Could not open event log for %s", path);
+    }
+
+    index_watch(wd, nwatches - 1);
+
+    log_info("Watching %s (wd %i)", path, wd);
+    return w;
+}
+
+
+/* register a single path in the kernel and append it to the wd->rule
+ * table. Returns the new entry, or NULL if the kernel refused the watch */
+static watch_t *
+add_watch(rule_t * rule, char * path, char * prepend, char * command)
+{
+    int wd = inotify_add_watch(fd, path, IN_ALL_EVENTS);
+    if (wd < 0) {
+        log_warn("Could not add watch on %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    /* the kernel returns the same wd for an already-watched path, so a
+     * re-walk over registered ground never duplicates table entries. A
+     * reload that kept the path but changed the rule lands here too and
+     * must rebind the entry: left on the old rule, the subsequent drop
+     * of that rule would rm_watch this wd and leave the path dead */
+    watch_t *existing = find_watch(wd);
+    if (existing != NULL) {
+        if (existing->rule != rule) {
+            log_info("Rebinding %s (wd %i) to its reloaded rule", path, wd);
+            existing->rule = rule;
+            existing->prepend = prepend;
+            existing->command = command;
+
+            eventlog_close(existing->elog);
+            existing->elog = NULL;
+            if (strcmp(prepend, "log") == 0) {
+                existing->elog = eventlog_open(command);
+                if (existing->elog == NULL)
+                    log_warn("Could not open event log for %s", path);
+            }
+        }
+        return existing;
+    }
+
+    return append_watch(wd, rule, path, prepend, command);
+}
+
+
+/* find the watch whose root path covers an absolute fanotify event path */
+static watch_t *
+match_path(const char * path)
+{
+    for (int i = 0; i < nwatches; i++) {
+        size_t len = strlen(watches[i].path);
+        if (strncmp(path, watches[i].path, len) == 0 &&
+            (path[len] == '\0' || path[len] == '/'))
+            return &watches[i];
+    }
+    return NULL;
+}
+
+
+/* recursively walk a directory tree, registering a watch per directory.
+ * Called at startup for recursive rules, and again from the event loop
+ * on each new subdirectory: walking the new child picks up any deeper
+ * directories created before its own watch landed */
+static void
+register_tree(rule_t * rule, char * path, char * prepend, char * command)
+{
+    if (add_watch(rule, path, prepend, command) == NULL)
+        return;
+
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+        return;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+            continue;
+
+        char child[PATH_MAX];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+
+        struct stat st;
+        if (lstat(child, &st) == 0 && S_ISDIR(st.st_mode))
+            register_tree(rule, child, prepend, command);
+    }
+
+    closedir(dir);
+}
+
+
+/* has the file's content actually changed since we last hashed it?
+ * Consults (and updates) the shard's digest cache; unreadable or empty
+ * files fail open so an action is never wrongly skipped */
+static bool
+content_changed(shard_t * sh, int wd, const char * name, const char * path)
+{
+    uint64_t h = hash_file(path);
+    if (h == 0)
+        return true;
+
+    unsigned hv = (unsigned) wd * 2654435761u;
+    for (const char *s = name; *s != '\0'; s++)
+        hv = hv * 31 + (unsigned char) *s;
+
+    for (int probe = 0; probe < 8; probe++) {
+        digest_t *de = &sh->digests[(hv + probe) % DIGEST_MAX];
+
+        if (de->used && de->wd == wd && !strcmp(de->name, name)) {
+            if (de->hash == h)
+                return false;
+            de->hash = h;
+            return true;
+        }
+
+        if (!de->used) {
+            de->used = true;
+            de->wd = wd;
+            strncpy(de->name, name, NAME_MAX);
+            de->name[NAME_MAX] = '\0';
+            de->hash = h;
+            return true;
+        }
+    }
+
+    /* collision chain exhausted: treat as changed */
+    return true;
+}
+
+
+/* run the configured pipeline for one logical event: report it, raise a
+ * notification, and fire the matching rule's action. sh is the calling
+ * shard's state and read_ts the moment the event left the kernel (both
+ * NULL during startup/reload catch-up) */
+static void
+dispatch_event(shard_t * sh, int wd, uint32_t mask, int count,
+               const char * name, const struct timespec * read_ts)
+{
+    watch_t *w = find_watch(wd);
+    if (w == NULL) {
+        log_debug("No rule for wd %i, skipping", wd);
+        return;
+    }
+
+    const char *event;
+
+    /* report the event: a connected collector gets a batched JSONL
+     * record, otherwise it goes to the terminal */
+    event = get_event(mask);
+    if (sink_active())
+        sink_emit(wd, mask, count, event, name);
+    else
+        report_emit(event, w->path, count);
+
+    /* raise notification if flag was set; the timestamp string is only
+     * formatted when a sink actually consumes it */
+    if (notifier) {
+        log_debug("Raising notification");
+        raise_notification(get_cached_time(), event);
+    }
+
+    /* if the event matches the rule, hand the command to the worker
+     * pool; mask prefilter first, so a miss never reaches strcmp */
+    if (mask & w->rule->mask) {
+        STAT_INC(matches);
+
+        /* SLO instrumentation: how long from the kernel read to here */
+        struct timespec match_ts;
+        clock_gettime(CLOCK_MONOTONIC, &match_ts);
+        if (read_ts != NULL)
+            stats_hist_record(&fg_hist_read_match,
+                              (match_ts.tv_sec - read_ts->tv_sec) * 1000000000L
+                            + (match_ts.tv_nsec - read_ts->tv_nsec));
+
+        /* full path of the affected file rides along as context */
+        char full[PATH_MAX];
+        if (name[0] != '\0')
+            snprintf(full, sizeof(full), "%s/%s", w->path, name);
+        else
+            snprintf(full, sizeof(full), "%s", w->path);
+
+        /* if-changed rule: a close-write that rewrote identical bytes
+         * is a no-op, skip the action instead of paying for it */
+        if (w->rule->if_changed && (mask & IN_CLOSE_WRITE) && sh != NULL
+                && !content_changed(sh, wd, name, full)) {
+            STAT_INC(unchanged);
+        } else if (strcmp(w->prepend, "execute") == 0
+                && executor_submit(w->command, full, event, wd, &match_ts) == 0) {
+            STAT_INC(actions_spawned);
+        }
+    }
+
+    if (strcmp(w->prepend, "log") == 0 && w->elog != NULL) {
+        /* one fixed-size record into the mmap'd ring: no open, no malloc */
+        eventlog_append(w->elog, wd, mask, count, name);
+    }
+}
+
+
+/* milliseconds elapsed since a monotonic timestamp */
+static long
+ms_since(struct timespec * then)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - then->tv_sec) * 1000
+         + (now.tv_nsec - then->tv_nsec) / 1000000;
+}
+
+
+/* consult (and refresh) the shard's cache: true means this exact tuple
+ * fired within the TTL and the event should be dropped. O(1), no
+ * allocation */
+static bool
+is_suppressed(shard_t * sh, int wd, uint32_t mask, const char * name)
+{
+    unsigned h = (unsigned) wd * 2654435761u ^ mask;
+    for (const char *s = name; *s != '\0'; s++)
+        h = h * 31 + (unsigned char) *s;
+
+    /* short probe run: a collision chain longer than this just lets the
+     * event through, which is the safe failure mode */
+    for (int probe = 0; probe < 8; probe++) {
+        supp_t *se = &sh->suppress[(h + probe) % SUPPRESS_MAX];
+
+        if (se->used && se->wd == wd && se->mask == mask
+                && !strcmp(se->name, name)) {
+            if (ms_since(&se->seen) < suppress_ms) {
+                clock_gettime(CLOCK_MONOTONIC, &se->seen);
+                return true;
+            }
+            /* expired: rearm the entry and let this one through */
+            clock_gettime(CLOCK_MONOTONIC, &se->seen);
+            return false;
+        }
+
+        if (!se->used || ms_since(&se->seen) >= suppress_ms) {
+            se->used = true;
+            se->wd = wd;
+            se->mask = mask;
+            strncpy(se->name, name, NAME_MAX);
+            se->name[NAME_MAX] = '\0';
+            clock_gettime(CLOCK_MONOTONIC, &se->seen);
+            return false;
+        }
+    }
+
+    return false;
+}
+
+
+/* fold a raw event into the shard's pending table: duplicates on the
+ * same (wd, name) within the window merge into one logical event */
+static void
+coalesce_event(shard_t * sh, int wd, uint32_t mask, const char * name,
+               const struct timespec * read_ts)
+{
+    /* cheap hash over wd and name for the open-addressed table */
+    unsigned h = (unsigned) wd * 2654435761u;
+    for (const char *s = name; *s != '\0'; s++)
+        h = h * 31 + (unsigned char) *s;
+
+    for (int probe = 0; probe < PENDING_MAX; probe++) {
+        pend_t *pe = &sh->pending[(h + probe) % PENDING_MAX];
+
+        if (pe->used && pe->wd == wd && !strcmp(pe->name, name)) {
+            pe->mask |= mask;
+            pe->count++;
+            STAT_INC(coalesced);
+            return;
+        }
+
+        if (!pe->used) {
+            pe->used = true;
+            pe->wd = wd;
+            strncpy(pe->name, name, NAME_MAX);
+            pe->name[NAME_MAX] = '\0';
+            pe->mask = mask;
+            pe->count = 1;
+            clock_gettime(CLOCK_MONOTONIC, &pe->first);
+            pe->read_ts = *read_ts;
+            sh->npending++;
+            return;
+        }
+    }
+
+    /* table full: dispatch straight away rather than dropping */
+    pthread_rwlock_rdlock(&table_lock);
+    dispatch_event(sh, wd, mask, 1, name, read_ts);
+    pthread_rwlock_unlock(&table_lock);
+}
+
+
+/* dispatch every pending entry whose window has closed (or all of them
+ * when force is set, e.g. on shutdown). Takes the table read lock
+ * itself, so callers must not hold it */
+static void
+flush_pending(shard_t * sh, bool force)
+{
+    if (sh->npending == 0)
+        return;
+
+    pthread_rwlock_rdlock(&table_lock);
+    for (int i = 0; i < PENDING_MAX && sh->npending > 0; i++) {
+        pend_t *pe = &sh->pending[i];
+        if (!pe->used)
+            continue;
+
+        if (force || ms_since(&pe->first) >= coalesce_ms) {
+            pe->used = false;
+            sh->npending--;
+            dispatch_event(sh, pe->wd, pe->mask, pe->count, pe->name,
+                           &pe->read_ts);
+        }
+    }
+    pthread_rwlock_unlock(&table_lock);
+}
+
+
+/* idle power mode: after this many quiet seconds the kernel masks are
+ * narrowed to just the events rules subscribe to and the poll timeout
+ * stretches, so an idle fleet stops waking up for stray IN_OPENs */
+#define IDLE_AFTER_SECS 30
+#define ACTIVE_POLL_MS  500
+#define IDLE_POLL_MS    5000
+
+/* re-mark every live watch: narrow masks carry only the bits rules
+ * reference (plus IN_CREATE where recursion needs it), full masks
+ * restore complete fidelity while events are flowing */
+static void
+set_watch_masks(bool narrow)
+{
+    pthread_rwlock_rdlock(&table_lock);
+    for (int i = 0; i < nwatches; i++) {
+        watch_t *w = &watches[i];
+        if (w->wd < 0 || w->path == NULL)
+            continue;
+
+        uint32_t mask = IN_ALL_EVENTS;
+        if (narrow) {
+            mask = w->rule->mask;
+            if (w->rule->recursive)
+                mask |= IN_CREATE;
+        }
+
+        /* same path, same wd: the kernel just swaps the mask */
+        inotify_add_watch(fd, w->path, mask);
+    }
+    pthread_rwlock_unlock(&table_lock);
+}
+
+
+/* how long the reader parks on a full shard ring before giving up on
+ * the record, in 1 ms naps. Already-drained events can't go back to
+ * the kernel, so backpressure here is the last line before real loss */
+#define RING_PUSH_RETRIES 100
+
+/* push with backpressure: a full ring briefly parks the reader so the
+ * dispatcher catches up and the kernel queue absorbs the burst
+ * upstream, instead of discarding events we already drained. Bounded,
+ * so a wedged dispatcher can't hang shutdown; a record lost anyway is
+ * counted where the stats surface can see it */
+static bool
+push_event(shard_t * sh, const spsc_rec_t * rec)
+{
+    for (int tries = 0; tries < RING_PUSH_RETRIES; tries++) {
+        if (spsc_push(&sh->q, rec))
+            return true;
+        if (!sc)
+            break;
+
+        struct timespec nap = { 0, 1000000 };
+        nanosleep(&nap, NULL);
+    }
+
+    STAT_INC(ring_dropped);
+    return false;
+}
+
+
+/* reader stage: drain the kernel fd in large batches and push normalized
+ * records onto the ring. All rule and table work happens on the
+ * dispatcher, so this thread runs at memcpy speed */
+static void *
+reader_main(void * unused)
+{
+    int epfd = epoll_create1(0);
+    if (epfd < 0) {
+        perror("Could not initialize epoll. Reason");
+        exit(EXIT_FAILURE);
+    }
+
+    struct epoll_event epev;
+    epev.events = EPOLLIN;
+    epev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &epev) < 0) {
+        perror("Could not register backend fd with epoll. Reason");
+        exit(EXIT_FAILURE);
+    }
+
+    /* event drain buffer: sized for thousands of events per read so a
+     * burst is bounded by processing, not by syscall count. It grows on
+     * demand (FIONREAD) so the whole kernel queue drains in one read */
+    size_t buf_len = DRAIN_BUF_LEN;
+    char *buf = malloc(buf_len);
+    if (buf == NULL) {
+        perror("malloc failed. Reason");
+        exit(EXIT_FAILURE);
+    }
+
+    /* watermark over the queue limit, in conservative (header-only)
+     * bytes: crossing it means a drop is close even for tiny events */
+    size_t wm_bytes = (size_t) queue_limit_events / 10 * 8
+                    * sizeof(struct inotify_event);
+    bool above_wm = false;
+
+    /* idle-mode state: when the last event was seen and whether the
+     * kernel masks are currently narrowed */
+    int poll_ms = ACTIVE_POLL_MS;
+    bool idle = false;
+    struct timespec last_event;
+    clock_gettime(CLOCK_MONOTONIC, &last_event);
+
+    while (sc) {
+        /* finite timeout so shutdown is noticed promptly */
+        int nfds = epoll_wait(epfd, &epev, 1, poll_ms);
+        if (nfds < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait failed. Reason");
+            break;
+        }
+        if (nfds == 0) {
+            /* quiet long enough: drop to the narrow masks and the long
+             * timeout until something happens again */
+            if (!idle && backend_kind == BACKEND_INOTIFY
+                    && ms_since(&last_event) >= IDLE_AFTER_SECS * 1000L) {
+                log_debug("Idle: narrowing watch masks");
+                set_watch_masks(true);
+                idle = true;
+                poll_ms = IDLE_POLL_MS;
+            }
+            continue;
+        }
+
+        /* how much is queued right now: grow the buffer to take all of
+         * it in one read, and flag saturation before the kernel drops */
+        int avail = 0;
+        if (ioctl(fd, FIONREAD, &avail) == 0 && avail > 0) {
+            if ((size_t) avail >= wm_bytes) {
+                if (!above_wm) {
+                    STAT_INC(watermark_hits);
+                    log_warn("inotify queue above 80%% (%i bytes queued)", avail);
+                }
+                above_wm = true;
+            } else {
+                above_wm = false;
+            }
+
+            if ((size_t) avail > buf_len) {
+                char *grown = realloc(buf, avail);
+                if (grown != NULL) {
+                    buf = grown;
+                    buf_len = avail;
+                }
+            }
+        }
+
+        /* drain a large batch of queued events in one syscall; epoll is
+         * level-triggered, so anything left over wakes us right back up */
+        int rd = read(fd, buf, buf_len);
+        if (rd < 0) {
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+            perror("Couldn't read event. Reason");
+            break;
+        }
+
+        STAT_ADD(bytes_drained, rd);
+
+        /* traffic: restore full masks and the short timeout */
+        clock_gettime(CLOCK_MONOTONIC, &last_event);
+        if (idle) {
+            log_debug("Activity: restoring full watch masks");
+            set_watch_masks(false);
+            idle = false;
+            poll_ms = ACTIVE_POLL_MS;
+        }
+
+        spsc_rec_t rec;
+        int dropped = 0;
+
+        /* one timestamp covers the whole batch: every record carries
+         * the moment its bytes left the kernel */
+        rec.read_ts = last_event;
+
+        /* fanotify records carry a path instead of a wd + name; resolve
+         * them to their watch here, since the table is static for this
+         * backend once registration is done */
+        if (backend_kind == BACKEND_FANOTIFY) {
+            fan_event_t fev;
+            int off = 0, used;
+            while ((used = fanotify_backend_next(buf, rd, off, &fev)) > 0) {
+                off += used;
+                STAT_INC(events_read);
+
+                watch_t *w = match_path(fev.path);
+                if (w == NULL || fev.mask == 0)
+                    continue;
+
+                /* store the path relative to the watch root, so the
+                 * name field has the same shape as on inotify: pattern
+                 * matching and the action context both depend on it */
+                const char *rel = fev.path + strlen(w->path);
+                if (*rel == '/')
+                    rel++;
+
+                rec.wd = w->wd;
+                rec.mask = fev.mask;
+                strncpy(rec.name, rel, NAME_MAX);
+                rec.name[NAME_MAX] = '\0';
+                if (!push_event(&shards[(unsigned) rec.wd % nshards], &rec))
+                    dropped++;
+            }
+        } else {
+            struct inotify_event *ev;
+            for (char *p = buf; p < buf + rd;) {
+                ev = (struct inotify_event *) p;
+                p += sizeof(struct inotify_event) + ev->len;
+                STAT_INC(events_read);
+
+                rec.wd = ev->wd;
+                rec.mask = ev->mask;
+                if (ev->len > 0) {
+                    strncpy(rec.name, ev->name, NAME_MAX);
+                    rec.name[NAME_MAX] = '\0';
+                } else {
+                    rec.name[0] = '\0';
+                }
+
+                /* same wd, same shard: per-file ordering is preserved */
+                if (!push_event(&shards[(unsigned) rec.wd % nshards], &rec))
+                    dropped++;
+            }
+        }
+
+        if (dropped > 0)
+            log_warn("Event ring full: dropped %i event(s)", dropped);
+    }
+
+    free(buf);
+    close(epfd);
+    return NULL;
+}
+
+
+/* dispatcher shard: consume normalized records off this shard's ring.
+ * Rule matching, filtering, coalescing and reporting all run here, in
+ * parallel across shards; only watch-table mutation takes the write
+ * lock */
+static void *
+dispatch_main(void * arg)
+{
+    shard_t *sh = arg;
+    stats_shard = (int) (sh - shards) + 1;
+
+    spsc_rec_t rec;
+    int since_flush = 0;
+
+    while (sc) {
+        if (!spsc_pop(&sh->q, &rec)) {
+            /* idle: close out expired windows, recycle scratch, nap */
+            flush_pending(sh, false);
+            sink_flush();
+            report_flush();
+            log_flush();
+            arena_reset(&sh->scratch);
+            since_flush = 0;
+
+            struct timespec nap = { 0, 1000000 };
+            nanosleep(&nap, NULL);
+            continue;
+        }
+
+        /* the kernel queue overflowed: events were lost. Surface it on
+         * the report path too, since the stderr warning is invisible
+         * to anything consuming stdout (quiet mode, the bench pipe) */
+        if (rec.mask & IN_Q_OVERFLOW) {
+            STAT_INC(overflows);
+            if (sink_active())
+                sink_emit(rec.wd, rec.mask, 1, get_event(rec.mask), "");
+            else
+                report_emit(get_event(rec.mask), "the kernel queue", 1);
+            log_warn("inotify queue overflow: the kernel dropped events");
+            continue;
+        }
+
+        pthread_rwlock_rdlock(&table_lock);
+        watch_t *w = find_watch(rec.wd);
+        if (w == NULL) {
+            pthread_rwlock_unlock(&table_lock);
+            log_debug("No rule for wd %i, skipping", rec.wd);
+            continue;
+        }
+
+        bool new_subdir = backend_kind == BACKEND_INOTIFY && w->rule->recursive
+                && (rec.mask & IN_CREATE) && (rec.mask & IN_ISDIR);
+        bool pattern_ok = match_pattern(w->rule, rec.name);
+        pthread_rwlock_unlock(&table_lock);
+
+        /* a new subdirectory under a recursive rule gets watched
+         * immediately. Walk it rather than marking just the child: any
+         * directories created inside it before this watch landed would
+         * otherwise be missed forever */
+        if (new_subdir) {
+            pthread_rwlock_wrlock(&table_lock);
+            /* re-resolve: the table may have moved since the read */
+            w = find_watch(rec.wd);
+            if (w != NULL) {
+                size_t child_len = strlen(w->path) + strlen(rec.name) + 2;
+                char *child = arena_alloc(&sh->scratch, child_len);
+                if (child != NULL) {
+                    snprintf(child, child_len, "%s/%s", w->path, rec.name);
+                    register_tree(w->rule, child, w->prepend, w->command);
+                }
+            }
+            pthread_rwlock_unlock(&table_lock);
+        }
+
+        /* filename filter: reject non-matching events right here, before
+         * they touch timestamping, coalescing, logging or actions */
+        if (!pattern_ok)
+            continue;
+
+        /* TTL suppression: an identical tuple fired moments ago, drop
+         * this one before it reaches coalescing or action matching */
+        if (suppress_ms > 0 && is_suppressed(sh, rec.wd, rec.mask, rec.name)) {
+            STAT_INC(suppressed);
+            continue;
+        }
+
+        /* merge into the pending table, or dispatch straight away
+         * when no coalescing window is configured */
+        if (coalesce_ms > 0) {
+            coalesce_event(sh, rec.wd, rec.mask, rec.name, &rec.read_ts);
+        } else {
+            pthread_rwlock_rdlock(&table_lock);
+            dispatch_event(sh, rec.wd, rec.mask, 1, rec.name, &rec.read_ts);
+            pthread_rwlock_unlock(&table_lock);
+        }
+
+        /* under sustained load, still close windows periodically */
+        if (++since_flush >= 256) {
+            since_flush = 0;
+            flush_pending(sh, false);
+        }
+    }
+
+    return NULL;
+}
+
+
+/* detach from the terminal: double-fork/setsid, pidfile, stdio onto
+ * /dev/null. The working directory is kept so relative config paths
+ * still resolve */
+static void
+daemonize(void)
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Could not fork. Reason");
+        exit(EXIT_FAILURE);
+    }
+    if (pid > 0)
+        _exit(EXIT_SUCCESS);
+
+    if (setsid() < 0) {
+        perror("Could not create session. Reason");
+        exit(EXIT_FAILURE);
+    }
+
+    /* second fork: never reacquire a controlling terminal */
+    pid = fork();
+    if (pid < 0) {
+        perror("Could not fork. Reason");
+        exit(EXIT_FAILURE);
+    }
+    if (pid > 0)
+        _exit(EXIT_SUCCESS);
+
+    FILE *pf = fopen(DEFAULT_PIDFILE, "w");
+    if (pf != NULL) {
+        fprintf(pf, "%i\n", getpid());
+        fclose(pf);
+    }
+
+    int devnull = open("/dev/null", O_RDWR);
+    if (devnull >= 0) {
+        dup2(devnull, STDIN_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        if (devnull > STDERR_FILENO)
+            close(devnull);
+    }
+}
+
+
+/* supervisor shutdown: forward the signal to the worker, drop the
+ * pidfile, and go away without running the worker's cleanup path */
+static void
+supervisor_term(int s)
+{
+    if (worker_pid > 0)
+        kill(worker_pid, SIGTERM);
+    unlink(DEFAULT_PIDFILE);
+    _exit(EXIT_SUCCESS);
+}
+
+
+/* supervision loop: the parent keeps the backend fd open and re-forks
+ * the worker when it dies, so the kernel event queue (and every
+ * registered watch, which belongs to the fd) survives a worker crash.
+ * Returns only in the worker child */
+static void
+supervise(void)
+{
+    signal(SIGTERM, supervisor_term);
+    signal(SIGINT, supervisor_term);
+
+    for (;;) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("Could not fork worker. Reason");
+            exit(EXIT_FAILURE);
+        }
+
+        if (pid == 0) {
+            /* worker: restore the normal handlers and carry on */
+            signal(SIGTERM, catch_sig);
+            signal(SIGINT, catch_sig);
+            return;
+        }
+
+        worker_pid = pid;
+        int status;
+        if (waitpid(pid, &status, 0) < 0) {
+            unlink(DEFAULT_PIDFILE);
+            exit(EXIT_FAILURE);
+        }
+
+        /* a clean exit means the worker was asked to stop */
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            unlink(DEFAULT_PIDFILE);
+            exit(EXIT_SUCCESS);
+        }
+
+        /* crash: brief backoff, then a warm restart against the same fd */
+        struct timespec backoff = { 0, 100000000 };
+        nanosleep(&backoff, NULL);
+    }
+}
+
+
+/* validate one rule and register its watches in the kernel. Returns 0 on
+ * success, -1 with the failure printed so startup can abort and a hot
+ * reload can skip just the bad rule */
+static int
+register_rule(rule_t * rule, int r, snapshot_t * snap)
+{
+    if (rule->inode == NULL || rule->event == NULL || rule->action == NULL) {
+        fprintf(stderr, "Rule %i is missing an inode, event or action key.\n", r);
+        return -1;
+    }
+
+    log_debug("Rule %i: inode: %s event: %s action: %s",
+              r, rule->inode, rule->event, rule->action);
+
+    /* compile the event name to its mask bit once, at load time */
+    rule->mask = parse_event(rule->event);
+    if (rule->mask == 0) {
+        fprintf(stderr, "\nUnknown inode event supplied: %s\n", rule->event);
+        return -1;
+    }
+
+    /* compile the filename filter to its fast-path matcher */
+    compile_pattern(rule);
+    if (rule->pattern != NULL)
+        log_debug("Rule %i filters on pattern %s", r, rule->pattern);
+
+    /* check if specified inode is an inode */
+    file_t inode_check;
+    inode_check = file_check(rule->inode);
+    if (inode_check.flag < 0) {
+        fprintf(stderr, "Error %i: Unable to open inode \"%s\": %s\n",
+                inode_check.flag, rule->inode, inode_check.data);
+        return -1;
+    }
+
+    /* check for proper permissions */
+    int iperm;
+    iperm = check_inode_permissions(rule->inode);
+    if (iperm < 0) {
+        perror("Permission check for inode failed! Reason");
+        return -1;
+    }
+
+    /* tokenize the action string once, up front */
+    char *str, *prepend, *command;
+    str = strdup(rule->action);
+    prepend = strtok(str, " ");
+    command = strtok(NULL, "\"");
+
+    if (command == NULL) {
+        fprintf(stderr, "Command/path cannot be none. Exiting.\n");
+        return -1;
+    }
+
+    /* fanotify: one filesystem mark covers the rule's whole mount,
+     * recorded with a synthetic wd for the shared dispatch table */
+    if (backend_kind == BACKEND_FANOTIFY) {
+        /* the mark only subscribes to access/modify/open/close, so a
+         * rule keyed on anything else would never fire on this backend */
+        if ((rule->mask & FANOTIFY_DELIVERABLE) == 0) {
+            fprintf(stderr, "Event %s is not deliverable by the fanotify "
+                    "backend; use inotify for rule %i.\n", rule->event, r);
+            return -1;
+        }
+        if ((rule->mask & ~FANOTIFY_DELIVERABLE) != 0)
+            log_warn("Rule %i: fanotify only delivers access/modify/open/close;"
+                     " other bits of event %s will not fire", r, rule->event);
+
+        if (fanotify_backend_mark(fd, rule->inode) < 0) {
+            perror("Could not add fanotify mark. Reason");
+            return -1;
+        }
+        append_watch(r + 1, rule, rule->inode, prepend, command);
+        return 0;
+    }
+
+    /* recursive rule with a snapshot: register from the saved list,
+     * stat-scanning for directories that changed while we were down */
+    if (rule->recursive && snap != NULL) {
+        int restored = 0;
+        for (int i = 0; i < snap->count; i++) {
+            if (snap->entries[i].rule != (uint32_t) r)
+                continue;
+
+            watch_t *w = add_watch(rule, snap->entries[i].path, prepend, command);
+            restored++;
+
+            /* mtime moved while we were down: re-walk just this
+             * directory and surface a catch-up event */
+            struct stat st;
+            if (w != NULL && stat(w->path, &st) == 0
+                    && st.st_mtime != snap->entries[i].mtime) {
+                register_tree(rule, w->path, prepend, command);
+                dispatch_event(NULL, w->wd, IN_MODIFY, 1, "", NULL);
+            }
+        }
+
+        if (restored > 0)
+            return 0;
+        /* empty or foreign snapshot: fall through to a full walk */
+    }
+
+    /* add a file watcher and record it in the table; a recursive rule
+     * walks the subtree once and watches every directory in it */
+    if (rule->recursive)
+        register_tree(rule, rule->inode, prepend, command);
+    else if (add_watch(rule, rule->inode, prepend, command) == NULL) {
+        perror("Could not add watch. Reason");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* two rules describe the same watch if every user-visible field agrees */
+static bool
+rule_same(rule_t * a, rule_t * b)
+{
+    if (strcmp(a->inode, b->inode) || strcmp(a->event, b->event)
+            || strcmp(a->action, b->action) || a->recursive != b->recursive)
+        return false;
+    if ((a->pattern == NULL) != (b->pattern == NULL))
+        return false;
+    return a->pattern == NULL || strcmp(a->pattern, b->pattern) == 0;
+}
+
+
+/* tear down every live watch registered for a rule that left the config */
+static void
+drop_watches_for(rule_t * rule)
+{
+    for (int i = 0; i < nwatches; i++) {
+        watch_t *w = &watches[i];
+        if (w->rule != rule || w->wd < 0)
+            continue;
+
+        log_info("Unwatching %s (wd %i)", w->path, w->wd);
+        inotify_rm_watch(fd, w->wd);
+        if (w->wd < wd_index_len)
+            wd_index[w->wd] = -1;
+        eventlog_close(w->elog);
+        w->elog = NULL;
+        free(w->path);
+        w->path = NULL;
+        w->wd = -1;
+    }
+}
+
+
+/* SIGHUP hot reload: re-parse the YAML and apply only the delta against
+ * the live table. Unchanged rules keep their wds (and the events queued
+ * against them); only added/removed rules pay registration cost */
+static void
+reload_config(void)
+{
+    reload_pending = 0;
+
+    if (backend_kind != BACKEND_INOTIFY) {
+        log_warn("Hot reload is only supported on the inotify backend");
+        return;
+    }
+
+    yaml_t ny = parse_yaml_config(yaml_target);
+    if (ny.return_flag == false || ny.nrules == 0) {
+        log_warn("Reload: could not parse %s, keeping current config", yaml_target);
+        return;
+    }
+
+    log_info("Reloading configuration from %s", yaml_target);
+
+    /* retarget watches of unchanged rules onto their new rule structs,
+     * so the old array can be freed once the delta is applied */
+    bool *matched_old = calloc(y.nrules, sizeof(bool));
+    for (int n = 0; n < ny.nrules; n++) {
+        rule_t *nr = &ny.rules[n];
+        rule_t *old = NULL;
+
+        for (int o = 0; o < y.nrules; o++) {
+            if (!matched_old[o] && rule_same(&y.rules[o], nr)) {
+                old = &y.rules[o];
+                matched_old[o] = true;
+                break;
+            }
+        }
+
+        if (old != NULL) {
+            nr->mask = old->mask;
+            compile_pattern(nr);
+            for (int i = 0; i < nwatches; i++)
+                if (watches[i].rule == old)
+                    watches[i].rule = nr;
+        } else if (register_rule(nr, n, NULL) < 0) {
+            log_warn("Reload: skipping invalid rule %i", n);
+        }
+    }
+
+    /* rules that left the config lose their watches */
+    int dropped = 0;
+    for (int o = 0; o < y.nrules; o++) {
+        if (!matched_old[o]) {
+            drop_watches_for(&y.rules[o]);
+            dropped++;
+        }
+    }
+    free(matched_old);
+
+    /* swap in the new rule table; rules and strings live in one pool,
+     * so retiring the old config is a single free */
+    free(y.pool);
+    y.pool = ny.pool;
+    y.rules = ny.rules;
+    y.nrules = ny.nrules;
+
+    coalesce_ms = ny.coalesce_ms;
+    suppress_ms = ny.suppress_ms;
+    log_info("Reload complete: %i rule(s) live, %i rule(s) dropped",
+             y.nrules, dropped);
+}
+
+
+/* serialize the live watch table so the next start can skip the walk */
+static void
+save_snapshot(void)
+{
+    if (y.snapshot == NULL || backend_kind != BACKEND_INOTIFY || nwatches == 0)
+        return;
+
+    snap_entry_t *entries = calloc(nwatches, sizeof(snap_entry_t));
+    if (entries == NULL)
+        return;
+
+    int n = 0;
+    for (int i = 0; i < nwatches; i++) {
+        struct stat st;
+        /* skip slots a hot reload retired */
+        if (watches[i].wd < 0 || watches[i].path == NULL)
+            continue;
+        entries[n].rule = watches[i].rule - y.rules;
+        entries[n].path = watches[i].path;
+        entries[n].mtime = (stat(watches[i].path, &st) == 0) ? st.st_mtime : 0;
+        n++;
+    }
+
+    snapshot_save(y.snapshot, entries, n);
+    free(entries);
+}
+
+
 /* cleanup routine called by atexit */
 static void
 cleanup(void)
 {
-    inotify_rm_watch(fd, wd);
+    for (int s = 0; shards != NULL && s < nshards; s++)
+        flush_pending(&shards[s], true);
+    save_snapshot();
+    log_flush();
+    report_shutdown();
+    sink_shutdown();
+    stats_endpoint_shutdown();
+    executor_shutdown();
+    notify_session_end();
+    for (int i = 0; i < nwatches; i++) {
+        if (watches[i].wd < 0)
+            continue;
+        if (backend_kind == BACKEND_INOTIFY)
+            inotify_rm_watch(fd, watches[i].wd);
+        eventlog_close(watches[i].elog);
+        watches[i].elog = NULL;
+    }
+
+    /* leave the counters and latency histograms behind on the way out */
+    if (verbose)
+        stats_dump(STDERR_FILENO);
+}
+
+
+/* SIGUSR1 dumps the pipeline counters to stderr */
+static void
+catch_usr1(int s)
+{
+    stats_dump(STDERR_FILENO);
+}
+
+
+/* SIGHUP just flags the reload; the dispatcher applies it between
+ * events, where the rule table is safe to mutate */
+static void
+catch_hup(int s)
+{
+    reload_pending = 1;
 }
 
 
-/* signal trapping routine that calls cleanup routine */
+/* signal trapping routine: only flag the shutdown. cleanup() takes the
+ * table lock and the sink mutexes and joins threads, none of which is
+ * async-signal-safe; main's loop sees sc drop, joins the pipeline and
+ * runs cleanup via atexit */
 static void
 catch_sig(int s)
 {
-    log_warn("Signal %i caught! Cleaning up...\n", s);
     sc = false;
-    cleanup();
-    exit(EXIT_SUCCESS);
 }
 
 
 int
 main(int argc, char **argv)
 {
-    /* represents a inotify_event struct */
-    struct inotify_event *ev;
-
-    /* default yaml file to check, parse and tokenize */
-    char *yaml_target = NULL;
-
-    /* return ints */
-    int rd;
-    int verbose;
-    int notifier;
-
     /* initialization */
     errno = 0;
     atexit(cleanup);
     signal(SIGINT, catch_sig);
+    signal(SIGUSR1, catch_usr1);
+    signal(SIGHUP, catch_hup);
 
     /* argument parsing */
     int c;
-    while ((c = getopt(argc, argv, "hvn")) != -1) {
+    while ((c = getopt(argc, argv, "hvnd")) != -1) {
        switch (c) {
 
            /* display help menu */
@@ -105,6 +1375,11 @@ main(int argc, char **argv)
                notifier = 1;
                break;
 
+           /* set daemon flag */
+           case 'd':
+               daemonized = 1;
+               break;
+
            /* default short to usage */
            default:
                usage(argv[0]);
@@ -112,11 +1387,14 @@ main(int argc, char **argv)
        }
    }
 
-    /* initialize verbosity */
-    if (!verbose)
+    /* initialize verbosity; verbose runs batch their log writes so a
+     * burst of events does not turn into a syscall per message */
+    if (!verbose) {
         log_set_quiet(1);
-    else
+    } else {
         log_set_level(3);
+        log_set_buffered(1);
+    }
 
 
     /* check argument list for any yaml file configuration changes */
@@ -156,139 +1434,159 @@ main(int argc, char **argv)
     log_debug("File %s found", yaml.data);
 
     /* parse our yaml configuration file */
-    yaml_t y;
     y = parse_yaml_config(yaml_target);
     if (y.return_flag == false) {
         perror("Could not initialize YAML parser. Reason");
         exit(EXIT_FAILURE);
     }
 
-    log_debug("Parsed YAML file: inode: %s event: %s execute: %s",
-              y.inode, y.event, y.action);
-
-    /* check if user-specified event is supported */
-    int event_flag;
-    for (int i = 0; events[i] != NULL; i++) {
-        if (strcmp(y.event, events[i]) == 0) { event_flag = 0; break; }
-        else                                 { event_flag = 1; continue; }
-    }
-
-    if (event_flag) {
-        fprintf(stderr, "\nUnknown inode event supplied: %s\n", y.event);
+    if (y.nrules == 0) {
+        fprintf(stderr, "No watch rules found in configuration. Exiting.\n");
         exit(EXIT_FAILURE);
     }
 
-    log_info("inode event found! Continuing.");
+    log_debug("Parsed YAML file: %i rule(s)", y.nrules);
 
-    /* check if specified inode is an inode */
-    file_t inode_check;
-    inode_check = file_check(y.inode);
-    if (inode_check.flag < 0) {
-        fprintf(stderr, "Error %i: Unable to open inode \"%s\": %s\n", inode_check.flag, y.inode, inode_check.data);
-        exit(EXIT_FAILURE);
+    /* pick up the coalescing window, if one was configured */
+    coalesce_ms = y.coalesce_ms;
+    if (coalesce_ms > 0)
+        log_info("Coalescing duplicate events within %i ms", coalesce_ms);
+
+    /* and the suppression TTL */
+    suppress_ms = y.suppress_ms;
+    if (suppress_ms > 0)
+        log_info("Suppressing duplicate events within %i ms", suppress_ms);
+
+    /* pick the notification backend */
+    if (y.backend != NULL) {
+        backend_kind = backend_from_name(y.backend);
+        if (backend_kind < 0) {
+            fprintf(stderr, "Unknown backend supplied: %s\n", y.backend);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* detach before the backend fd exists, so the supervisor owns it */
+    if (daemonized) {
+        daemonize();
+        if (notifier) {
+            log_warn("Notifications are disabled in daemon mode");
+            notifier = 0;
+        }
     }
 
-    log_info("inode successfully found and opened.");
+    /* initialize the backend: one nonblocking fd services every watch */
+    if (backend_kind == BACKEND_FANOTIFY)
+        fd = fanotify_backend_init();
+    else
+        fd = inotify_init1(IN_NONBLOCK);
 
-    /* check for proper permissions */
-    int iperm;
-    iperm = check_inode_permissions(y.inode);
-    if (iperm < 0) {
-        perror("Permission check for inode failed! Reason");
+    if (fd < 0) {
+        perror("Could not initialize notification backend. Reason");
         exit(EXIT_FAILURE);
     }
 
-    /* initialize inotify */
-    fd = inotify_init();
-    if (fd < 0)
-        perror("Could not initialize inotify. Reason");
+    /* supervisor parent holds the fd and re-forks the worker on crash:
+     * watches and queued events belong to the fd, so they survive */
+    if (daemonized)
+        supervise();
 
+    /* size the drain path against the host's actual queue limits */
+    if (backend_kind == BACKEND_INOTIFY)
+        probe_inotify_limits();
 
-    /* add a file watcher */
-    wd = inotify_add_watch(fd, y.inode, IN_ALL_EVENTS);
-    if (wd < 0)
-        perror("Could not add watch. Reason");
+    /* one persistent notification session for the whole run */
+    if (notifier && notify_session_init() < 0)
+        notifier = 0;
 
+    /* serve counters to collectors, if an endpoint was configured */
+    if (y.stats != NULL)
+        stats_endpoint_init(y.stats);
 
-    /* concatenate action string */
-    char *mem, *str, *prepend, *command;
-    mem = str = strdup(y.action);
-    prepend = strtok(str, " ");
-    command = strtok(NULL, "\"");
+    /* connect the structured output stream, if one was configured */
+    if (y.output != NULL)
+        sink_init(y.output);
 
-    if (command == NULL) {
-        fprintf(stderr, "Command/path cannot be none. Exiting.\n");
+    /* stdout reporting: batched into a pipe, line-at-a-time on a tty */
+    report_init(y.flush_ms);
+
+    /* spin up the action worker pool before any events (including the
+     * catch-up ones below) can fire */
+    if (executor_init(EXECUTOR_WORKERS) < 0) {
+        perror("Could not start executor pool. Reason");
         exit(EXIT_FAILURE);
     }
 
-    /* event buffers */
-    char buf[BUF_LEN] __attribute__ ((aligned(8)));
-    char *p;
-
-    /* main event loop */
-    while (sc) {
-        /* read from inotify fd */
-        rd = read(fd, buf, BUF_LEN);
-        if (rd == 0)
-            fprintf(stdout, "read() tossed back a 0");
-        else {
-            perror("Couldn't read event. Reason");
-            break;
-        }
+    /* a snapshot from the previous run lets recursive rules register
+     * straight from the saved path list instead of re-walking trees */
+    snapshot_t *snap = NULL;
+    if (y.snapshot != NULL && backend_kind == BACKEND_INOTIFY)
+        snap = snapshot_load(y.snapshot);
 
-        /* process events and do what's necessary according to YAML */
-        for (p = buf; p < buf + rd;) {
-
-            /* made local so that data gets re-initialized within scope */
-            struct tm * timeinfo;
-            time_t rawtime;
-            char *ltime, *eventstr;
-            const char *event;
+    /* validate each rule and register its watch */
+    for (int r = 0; r < y.nrules; r++) {
+        if (register_rule(&y.rules[r], r, snap) < 0)
+            exit(EXIT_FAILURE);
+    }
 
-            /* get time, and create new string */
-            timeinfo = gettime(rawtime);
-            ltime = asctime(timeinfo);
-            log_debug("Time of event: %s", ltime);
+    snapshot_close(snap);
 
-            /* copy over inotify_event */
-            ev = (struct inotify_event *) p;
+    /* shard count: clamp to the table the stats blocks can cover */
+    nshards = y.shards;
+    if (nshards < 1)
+        nshards = 1;
+    if (nshards > SHARDS_MAX)
+        nshards = SHARDS_MAX;
+    if (nshards > 1)
+        log_info("Dispatching across %i shards", nshards);
 
-            /* display event through terminal*/
-            event = get_event(ev);
-            printf("%s event ocurred\n", event);
+    /* shard state: one ring and scratch arena per dispatcher */
+    shards = calloc(nshards, sizeof(shard_t));
+    if (shards == NULL) {
+        perror("malloc failed. Reason");
+        exit(EXIT_FAILURE);
+    }
 
-            /* raise notification if flag was set */
-            log_debug("Raising notification");
-            if (notifier)
-                raise_notification(ltime, event);
+    for (int s = 0; s < nshards; s++) {
+        if (spsc_init(&shards[s].q, EVENT_RING_LEN) < 0
+                || arena_init(&shards[s].scratch, SCRATCH_ARENA_LEN) < 0) {
+            perror("malloc failed. Reason");
+            exit(EXIT_FAILURE);
+        }
+    }
 
-            /* check command, if the specified event matches the current event and execute accordingly */
-            if ((strcmp(prepend, "execute") == 0) && (strcmp(y.event, event) == 0))
-                system((const char *) command);
-            else if (strcmp(prepend, "log") == 0 ) {
+    /* reader stage first, then the dispatcher shards */
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, reader_main, NULL) != 0) {
+        perror("Could not start reader thread. Reason");
+        exit(EXIT_FAILURE);
+    }
 
-                if ((eventstr = malloc(strlen(ltime) + strlen(event) + 2)) != NULL) {
-                    eventstr[0] = '\0';
-                    strcat(eventstr, ltime);
-                    strcat(eventstr, event);
-                    strcat(eventstr, "\n");
-                } else {
-                    perror("malloc failed. Reason");
-                    exit(EXIT_FAILURE);
-                }
+    for (int s = 0; s < nshards; s++) {
+        if (pthread_create(&shards[s].thread, NULL, dispatch_main, &shards[s]) != 0) {
+            perror("Could not start dispatcher thread. Reason");
+            exit(EXIT_FAILURE);
+        }
+    }
 
-                /* create a log file, with contents of eventstr */
-                file_t tmpLog = create_file(command, eventstr);
-                if (tmpLog.flag < 0 ) {
-                    perror("Couldn't create log file. Reason");
-                    exit(EXIT_FAILURE);
-                }
-                free(eventstr);
-            }
-            p += sizeof(struct inotify_event) + ev->len;
+    /* this thread now only supervises: config reloads are applied here
+     * under the write lock, with every shard quiesced between events */
+    while (sc) {
+        if (reload_pending) {
+            pthread_rwlock_wrlock(&table_lock);
+            reload_config();
+            pthread_rwlock_unlock(&table_lock);
         }
+
+        struct timespec nap = { 0, 50000000 };
+        nanosleep(&nap, NULL);
     }
 
+    log_info("Signal caught! Cleaning up...");
+    pthread_join(reader, NULL);
+    for (int s = 0; s < nshards; s++)
+        pthread_join(shards[s].thread, NULL);
+
     /* success */
     exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,133 @@
+/*
+ * snapshot.c
+ *
+ *      Persistent watch-state snapshot. Shutdown serializes the
+ *      wd->path->rule table plus per-path mtimes into one compact
+ *      file; startup mmaps it back and registers watches straight
+ *      from the entry list instead of re-walking whole trees.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "snapshot.h"
+
+/* on-disk record framing: fixed fields, then path_len path bytes
+ * (nul included) */
+typedef struct
+{
+    uint32_t rule;
+    int64_t mtime;
+    uint32_t path_len;
+} snap_rec_t;
+
+
+int
+snapshot_save(char * file, snap_entry_t * entries, int count)
+{
+    FILE *fp = fopen(file, "w");
+    if (fp == NULL) {
+        log_warn("Could not write snapshot %s: %s", file, strerror(errno));
+        return -1;
+    }
+
+    snap_hdr_t hdr;
+    hdr.magic = SNAPSHOT_MAGIC;
+    hdr.version = SNAPSHOT_VERSION;
+    hdr.count = count;
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+
+    for (int i = 0; i < count; i++) {
+        snap_rec_t rec;
+        rec.rule = entries[i].rule;
+        rec.mtime = entries[i].mtime;
+        rec.path_len = strlen(entries[i].path) + 1;
+        fwrite(&rec, sizeof(rec), 1, fp);
+        fwrite(entries[i].path, rec.path_len, 1, fp);
+    }
+
+    fclose(fp);
+    log_info("Snapshot %s saved (%i entries)", file, count);
+    return 0;
+}
+
+
+snapshot_t *
+snapshot_load(char * file)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    off_t len = lseek(fd, 0, SEEK_END);
+    if (len < (off_t) sizeof(snap_hdr_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    snap_hdr_t *hdr = map;
+    if (hdr->magic != SNAPSHOT_MAGIC || hdr->version != SNAPSHOT_VERSION) {
+        log_warn("Snapshot %s has bad magic/version, ignoring", file);
+        munmap(map, len);
+        return NULL;
+    }
+
+    snapshot_t *snap = malloc(sizeof(snapshot_t));
+    snap_entry_t *entries = calloc(hdr->count, sizeof(snap_entry_t));
+    if (snap == NULL || entries == NULL) {
+        free(snap);
+        free(entries);
+        munmap(map, len);
+        return NULL;
+    }
+
+    /* walk the records, pointing entry paths into the mapping */
+    char *p = (char *) map + sizeof(snap_hdr_t);
+    char *end = (char *) map + len;
+    uint32_t n;
+    for (n = 0; n < hdr->count; n++) {
+        if (p + sizeof(snap_rec_t) > end)
+            break;
+
+        snap_rec_t *rec = (snap_rec_t *) p;
+        p += sizeof(snap_rec_t);
+        if (p + rec->path_len > end || rec->path_len == 0 || p[rec->path_len - 1] != '\0')
+            break;
+
+        entries[n].rule = rec->rule;
+        entries[n].mtime = rec->mtime;
+        entries[n].path = p;
+        p += rec->path_len;
+    }
+
+    snap->map = map;
+    snap->map_len = len;
+    snap->entries = entries;
+    snap->count = n;
+
+    log_info("Snapshot %s loaded (%i entries)", file, snap->count);
+    return snap;
+}
+
+
+void
+snapshot_close(snapshot_t * snap)
+{
+    if (snap == NULL)
+        return;
+
+    munmap(snap->map, snap->map_len);
+    free(snap->entries);
+    free(snap);
+}
@@ -0,0 +1,70 @@
+/*
+ * spsc.c
+ *
+ *      Lock-free single-producer/single-consumer ring. The reader
+ *      thread pushes normalized event records at memcpy speed and the
+ *      dispatcher pops them, so dispatch cost never backpressures the
+ *      kernel queue directly.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc.h"
+
+
+int
+spsc_init(spsc_t * q, size_t cap)
+{
+    /* round up to a power of two so wrap is a mask */
+    size_t real = 1;
+    while (real < cap)
+        real <<= 1;
+
+    q->slots = calloc(real, sizeof(spsc_rec_t));
+    if (q->slots == NULL)
+        return -1;
+
+    q->cap = real;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return 0;
+}
+
+
+bool
+spsc_push(spsc_t * q, const spsc_rec_t * rec)
+{
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if (tail - head == q->cap)
+        return false;
+
+    q->slots[tail & (q->cap - 1)] = *rec;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+
+bool
+spsc_pop(spsc_t * q, spsc_rec_t * rec)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if (head == tail)
+        return false;
+
+    *rec = q->slots[head & (q->cap - 1)];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+
+
+void
+spsc_destroy(spsc_t * q)
+{
+    free(q->slots);
+    q->slots = NULL;
+    q->cap = 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * stats.c
+ *
+ *      Hot-path instrumentation. The event loop bumps relaxed-atomic
+ *      counters; this module dumps them on demand (SIGUSR1) and serves
+ *      them to collectors over a unix stream socket.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "log.h"
+#include "stats.h"
+
+stats_t fg_stats[STATS_SHARDS_MAX];
+_Thread_local int stats_shard;
+
+hist_t fg_hist_read_match;
+hist_t fg_hist_match_spawn;
+
+
+long
+stats_ns_since(const struct timespec * then)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - then->tv_sec) * 1000000000L
+         + (now.tv_nsec - then->tv_nsec);
+}
+
+
+void
+stats_hist_record(hist_t * h, long ns)
+{
+    unsigned long us = (ns > 0) ? (unsigned long) ns / 1000 : 0;
+    int bucket = (us > 0) ? 63 - __builtin_clzl(us) : 0;
+    if (bucket >= HIST_BUCKETS)
+        bucket = HIST_BUCKETS - 1;
+
+    atomic_fetch_add_explicit(&h->counts[bucket], 1, memory_order_relaxed);
+}
+
+
+/* one histogram line: sample count plus log2-bucket percentile bounds */
+static void
+hist_dump(int fd, const char * name, hist_t * h)
+{
+    unsigned long counts[HIST_BUCKETS];
+    unsigned long total = 0;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        counts[i] = atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if (total == 0) {
+        dprintf(fd, "%s count=0\n", name);
+        return;
+    }
+
+    /* percentile upper bounds: the smallest bucket whose cumulative
+     * count covers the quantile; its range ends at 2^(i+1) us */
+    const int pcts[] = { 50, 90, 99 };
+    unsigned long bounds[3] = { 0, 0, 0 };
+    unsigned long seen = 0;
+    int p = 0;
+
+    for (int i = 0; i < HIST_BUCKETS && p < 3; i++) {
+        seen += counts[i];
+        while (p < 3 && seen * 100 >= total * (unsigned long) pcts[p])
+            bounds[p++] = 2ul << i;
+    }
+
+    dprintf(fd, "%s count=%lu p50<%luus p90<%luus p99<%luus\n",
+            name, total, bounds[0], bounds[1], bounds[2]);
+}
+
+/* endpoint state */
+static int listen_fd = -1;
+static char socket_path[108];
+static pthread_t endpoint_thread;
+static bool endpoint_running;
+
+
+void
+stats_dump(int fd)
+{
+    unsigned long events_read = 0, bytes_drained = 0, matches = 0;
+    unsigned long actions_spawned = 0, overflows = 0, coalesced = 0;
+    unsigned long watermark_hits = 0, suppressed = 0, unchanged = 0;
+    unsigned long ring_dropped = 0;
+
+    /* fold the per-shard blocks into process totals */
+    for (int s = 0; s < STATS_SHARDS_MAX; s++) {
+        stats_t *st = &fg_stats[s];
+        events_read += atomic_load_explicit(&st->events_read, memory_order_relaxed);
+        bytes_drained += atomic_load_explicit(&st->bytes_drained, memory_order_relaxed);
+        matches += atomic_load_explicit(&st->matches, memory_order_relaxed);
+        actions_spawned += atomic_load_explicit(&st->actions_spawned, memory_order_relaxed);
+        overflows += atomic_load_explicit(&st->overflows, memory_order_relaxed);
+        coalesced += atomic_load_explicit(&st->coalesced, memory_order_relaxed);
+        watermark_hits += atomic_load_explicit(&st->watermark_hits, memory_order_relaxed);
+        suppressed += atomic_load_explicit(&st->suppressed, memory_order_relaxed);
+        unchanged += atomic_load_explicit(&st->unchanged, memory_order_relaxed);
+        ring_dropped += atomic_load_explicit(&st->ring_dropped, memory_order_relaxed);
+    }
+
+    dprintf(fd,
+            "events_read:     %lu\n"
+            "bytes_drained:   %lu\n"
+            "matches:         %lu\n"
+            "actions_spawned: %lu\n"
+            "overflows:       %lu\n"
+            "coalesced:       %lu\n"
+            "watermark_hits:  %lu\n"
+            "suppressed:      %lu\n"
+            "unchanged:       %lu\n"
+            "ring_dropped:    %lu\n",
+            events_read, bytes_drained, matches, actions_spawned,
+            overflows, coalesced, watermark_hits, suppressed, unchanged,
+            ring_dropped);
+
+    /* pipeline latency distributions */
+    hist_dump(fd, "read_to_match: ", &fg_hist_read_match);
+    hist_dump(fd, "match_to_spawn:", &fg_hist_match_spawn);
+
+    /* per-shard breakdown for the dispatcher slots that saw traffic */
+    for (int s = 1; s < STATS_SHARDS_MAX; s++) {
+        stats_t *st = &fg_stats[s];
+        unsigned long m = atomic_load_explicit(&st->matches, memory_order_relaxed);
+        unsigned long c = atomic_load_explicit(&st->coalesced, memory_order_relaxed);
+        unsigned long d = atomic_load_explicit(&st->suppressed, memory_order_relaxed);
+        if (m + c + d > 0)
+            dprintf(fd, "shard %-2i:        matches=%lu coalesced=%lu suppressed=%lu\n",
+                    s - 1, m, c, d);
+    }
+}
+
+
+/* accept loop: every connection gets one dump, then the socket closes */
+static void *
+endpoint_main(void * unused)
+{
+    while (endpoint_running) {
+        int conn = accept(listen_fd, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        stats_dump(conn);
+        close(conn);
+    }
+
+    return NULL;
+}
+
+
+int
+stats_endpoint_init(char * path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_warn("Stats socket path too long: %s", path);
+        return -1;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        log_warn("Could not create stats socket: %s", strerror(errno));
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+            || listen(listen_fd, 4) < 0) {
+        log_warn("Could not bind stats socket %s: %s", path, strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+
+    strcpy(socket_path, path);
+    endpoint_running = true;
+    if (pthread_create(&endpoint_thread, NULL, endpoint_main, NULL) != 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+
+    log_info("Stats endpoint listening on %s", path);
+    return 0;
+}
+
+
+void
+stats_endpoint_shutdown(void)
+{
+    if (listen_fd < 0)
+        return;
+
+    endpoint_running = false;
+    shutdown(listen_fd, SHUT_RDWR);
+    close(listen_fd);
+    pthread_join(endpoint_thread, NULL);
+    unlink(socket_path);
+    listen_fd = -1;
+}